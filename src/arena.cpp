@@ -0,0 +1,293 @@
+#ifndef ARENA_CPP
+#define ARENA_CPP
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <sys/mman.h>
+#include "grid_view.cpp"
+#include "parallel_chunks.cpp"
+
+/*
+Counters of the arena, to see how much memory the engines map and how often it is reused.
+*/
+struct ArenaStats {
+    long mappings; //blocks mapped from the operating system
+    long reuses; //blocks handed out again from the pool
+    long hugeMappings; //blocks mapped with MAP_HUGETLB (the others are advised with MADV_HUGEPAGE)
+    long bytesMapped; //bytes currently mapped, in use or in the pool
+    long bytesInUse;
+    long scratchAllocations; //allocations from the per-thread scratch arenas
+    long scratchBytes;
+};
+
+/*
+Pool of large, page aligned memory blocks for the matrices of the engines.
+Blocks of 2 MB or more are rounded to 2 MB and backed by huge pages when possible: first with MAP_HUGETLB
+(which needs huge pages reserved by the system), otherwise with a 2 MB aligned mapping advised with
+MADV_HUGEPAGE so that transparent huge pages can back it. Smaller blocks are rounded to 4 KB pages.
+Released blocks are kept in the pool and handed out again to the next request of the same size, so that
+running the same computation several times (like the runs loop of the drivers) doesn't map and page fault
+the matrices again every time.
+*/
+class GridArena {
+public:
+    static constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+    static constexpr size_t PAGE = 4096;
+
+    static GridArena& instance() {
+        //never destroyed, the scratch arenas of the threads give their blocks back at thread exit
+        static GridArena* arena = new GridArena();
+        return *arena;
+    }
+
+    //returns a block of at least `bytes` bytes, aligned to a page (to 2 MB if it is that big)
+    void* acquire(size_t bytes) {
+        size_t size = roundUp(bytes);
+        std::lock_guard<std::mutex> lock(m);
+        auto it = freeBlocks.lower_bound(size);
+        //a free block is reused if it doesn't waste more than half of it
+        if (it != freeBlocks.end() && it->first <= 2 * size) {
+            void* block = it->second;
+            size = it->first;
+            freeBlocks.erase(it);
+            inUse[block] = size;
+            reuses++;
+            bytesInUse += size;
+            return block;
+        }
+        void* block = map(size);
+        if (!block) throw std::bad_alloc();
+        inUse[block] = size;
+        mappings++;
+        bytesMapped += size;
+        bytesInUse += size;
+        return block;
+    }
+
+    //gives a block back to the pool
+    void release(void* block) {
+        if (!block) return;
+        std::lock_guard<std::mutex> lock(m);
+        auto it = inUse.find(block);
+        if (it == inUse.end()) return;
+        freeBlocks.insert({it->second, block});
+        bytesInUse -= it->second;
+        inUse.erase(it);
+    }
+
+    //unmaps the blocks in the pool
+    void trim() {
+        std::lock_guard<std::mutex> lock(m);
+        for (auto& entry : freeBlocks) {
+            munmap(entry.second, entry.first);
+            bytesMapped -= entry.first;
+        }
+        freeBlocks.clear();
+    }
+
+    void addScratch(size_t bytes) {
+        scratchAllocations++;
+        scratchBytes += bytes;
+    }
+
+    ArenaStats stats() {
+        std::lock_guard<std::mutex> lock(m);
+        return ArenaStats{mappings, reuses, hugeMappings, bytesMapped, bytesInUse, scratchAllocations.load(), scratchBytes.load()};
+    }
+
+private:
+    std::mutex m;
+    std::multimap<size_t, void*> freeBlocks; //blocks in the pool, by size
+    std::map<void*, size_t> inUse; //size of the blocks handed out
+    long mappings = 0, reuses = 0, hugeMappings = 0, bytesMapped = 0, bytesInUse = 0;
+    std::atomic<long> scratchAllocations{0}, scratchBytes{0};
+
+    GridArena() {}
+
+    static size_t roundUp(size_t bytes) {
+        size_t unit = bytes >= HUGE_PAGE ? HUGE_PAGE : PAGE;
+        return std::max(unit, (bytes + unit - 1) / unit * unit);
+    }
+
+    void* map(size_t size) {
+        if (size < HUGE_PAGE) {
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return p == MAP_FAILED ? nullptr : p;
+        }
+#ifdef MAP_HUGETLB
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            hugeMappings++;
+            return p;
+        }
+#endif
+        //no huge pages reserved: map 2 MB more than needed and cut the mapping at a 2 MB boundary
+        char* raw = (char*) mmap(nullptr, size + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == (char*) MAP_FAILED) return nullptr;
+        char* aligned = (char*) (((uintptr_t) raw + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE);
+        if (aligned > raw) munmap(raw, aligned - raw);
+        char* end = raw + size + HUGE_PAGE;
+        if (end > aligned + size) munmap(aligned + size, end - (aligned + size));
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+        return aligned;
+    }
+};
+
+/*
+Matrix stored in a single block of the GridArena, row after row. The rows are padded to a multiple of 64
+bytes so that every row starts on a cache line. data[i][j] works like with the vector of vectors, since
+data[i] is the pointer to row i.
+The block goes back to the pool when the matrix is destroyed, and swapping two matrices only swaps the
+pointers, like std::swap of two vectors.
+*/
+template<typename T>
+class ArenaGrid {
+public:
+    ArenaGrid() {}
+
+    ArenaGrid(int rows, int cols) : numRows(rows), numCols(cols) {
+        stride = cols;
+        if (64 % sizeof(T) == 0) {
+            size_t per_line = 64 / sizeof(T);
+            stride = (cols + per_line - 1) / per_line * per_line;
+        }
+        if (rows > 0 && cols > 0) block = (T*) GridArena::instance().acquire((size_t) rows * stride * sizeof(T));
+    }
+
+    /*
+    The rows are copied by nworkers threads (parallelChunks), so that the pages of a block that was just
+    mapped are first touched, and placed on the NUMA node of, the workers instead of the calling thread.
+    */
+    ArenaGrid(const std::vector<std::vector<T>>& data, int nworkers = 1) : ArenaGrid(data.size(), data.empty() ? 0 : data[0].size()) {
+        parallelChunks(numRows, nworkers, [&](int start, int stop) {
+            for (int i = start; i < stop; i++) {
+                std::copy(data[i].begin(), data[i].end(), (*this)[i]);
+            }
+        });
+    }
+
+    explicit ArenaGrid(GridView<T> other) : ArenaGrid(other.rows(), other.cols()) {
+        copyGrid(other, view());
+    }
+
+    ArenaGrid(const ArenaGrid& other) : ArenaGrid(other.numRows, other.numCols) {
+        if (block) memcpy(block, other.block, (size_t) numRows * stride * sizeof(T));
+    }
+
+    ArenaGrid(ArenaGrid&& other) noexcept {
+        swap(other);
+    }
+
+    ArenaGrid& operator=(ArenaGrid other) {
+        swap(other);
+        return *this;
+    }
+
+    ~ArenaGrid() {
+        GridArena::instance().release(block);
+    }
+
+    void swap(ArenaGrid& other) noexcept {
+        std::swap(block, other.block);
+        std::swap(numRows, other.numRows);
+        std::swap(numCols, other.numCols);
+        std::swap(stride, other.stride);
+    }
+
+    T* operator[](int i) { return block + (size_t) i * stride; }
+    const T* operator[](int i) const { return block + (size_t) i * stride; }
+
+    int rows() const { return numRows; }
+    int cols() const { return numCols; }
+    size_t rowStride() const { return stride; }
+    T* data() { return block; }
+    const T* data() const { return block; }
+    bool empty() const { return block == nullptr; }
+
+    GridView<T> view() { return GridView<T>(block, numRows, numCols, stride); }
+
+    std::vector<std::vector<T>> toVector() const {
+        std::vector<std::vector<T>> result(numRows);
+        for (int i = 0; i < numRows; i++) {
+            result[i].assign((*this)[i], (*this)[i] + numCols);
+        }
+        return result;
+    }
+
+private:
+    T* block = nullptr;
+    int numRows = 0;
+    int numCols = 0;
+    size_t stride = 0; //elements from one row to the next
+};
+
+template<typename T>
+void swap(ArenaGrid<T>& a, ArenaGrid<T>& b) noexcept {
+    a.swap(b);
+}
+
+/*
+Per-thread bump allocator for the temporary buffers of the workers.
+allocate() just moves a pointer forward in a block taken from the GridArena, and reset() frees everything
+at once, so the workers don't go through malloc (and its locks) for memory that only lives during one
+task. The blocks are kept between resets and given back to the GridArena when the thread exits.
+*/
+class ScratchArena {
+public:
+    static constexpr size_t BLOCK = GridArena::HUGE_PAGE;
+
+    static ScratchArena& local() {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    template<typename T>
+    T* allocate(size_t n) {
+        size_t bytes = (n * sizeof(T) + 63) / 64 * 64;
+        while (current < blocks.size() && used + bytes > blocks[current].size) {
+            current++;
+            used = 0;
+        }
+        if (current == blocks.size()) {
+            size_t size = std::max(BLOCK, bytes);
+            blocks.push_back(Block{GridArena::instance().acquire(size), size});
+            used = 0;
+        }
+        T* p = (T*) ((char*) blocks[current].memory + used);
+        used += bytes;
+        GridArena::instance().addScratch(bytes);
+        return p;
+    }
+
+    //everything allocated since the last reset can be reused
+    void reset() {
+        current = 0;
+        used = 0;
+    }
+
+    ~ScratchArena() {
+        for (auto& block : blocks) GridArena::instance().release(block.memory);
+    }
+
+private:
+    struct Block {
+        void* memory;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t current = 0; //block being filled
+    size_t used = 0; //bytes used in the current block
+
+    ScratchArena() {}
+};
+
+#endif
\ No newline at end of file
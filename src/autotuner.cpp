@@ -0,0 +1,271 @@
+#ifndef AUTOTUNER_CPP
+#define AUTOTUNER_CPP
+
+#include <vector>
+#include <functional>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <typeinfo>
+#include <limits>
+#include <memory>
+#include "stencil_engine.cpp"
+
+/*
+A configuration of the stencil computation: which implementation runs it, with how many workers, how
+many chunks per worker and which tiles (for the engines that split the matrix in tiles). usec is the time
+per iteration measured when the configuration was benchmarked.
+chunksPerWorker is read by every engine as a target of about nworkers*chunksPerWorker pieces of work per
+iteration, but each one hands them out in its own way:
+    par_threads       chunks of consecutive tiles in the queue of the IterationRunner
+    par_omp           chunk size of the dynamic schedule, n_tiles / (nworkers*chunksPerWorker)
+    par_ff            grain of the ParallelFor, n_tiles / (nworkers*chunksPerWorker), so the same number
+                      of chunks, scheduled by FastFlow
+    par_ff_wavefront  bands of rows of the wavefront, when the band height is not given
+    seq               not used
+so the same value gives about the same number of chunks on the tiled engines, and a tuned value can be
+compared between them.
+*/
+struct TuningConfig {
+    std::string backend; //name of the engine in the StencilEngineRegistry
+    int nworkers = 1;
+    int chunksPerWorker = CHUNKS_PER_WORKER;
+    double usec = 0;
+    TileShape tileShape; //0 is chosen from the cache sizes
+};
+
+/*
+Autotuner of the stencil computation.
+For a given problem (matrix size, neighborhood, stencil function and data type) it benchmarks the
+candidate configurations on the current machine, and stores the fastest one in a tuning cache file, keyed
+by the problem signature and the hardware signature. Later runs of the same problem on the same kind of
+machine read the configuration from the cache instead of benchmarking again.
+The cache file has one configuration per line:
+    problem signature <tab> hardware signature <tab> backend nworkers chunksPerWorker usec tileRows tileCols
+where a tile size of 0 is chosen from the cache sizes. The lines written before the tiles were tuned end
+after usec, and are read with the default tiles.
+*/
+template<typename T>
+class StencilAutotuner {
+public:
+    StencilAutotuner(std::string cacheFile, int tuneIterations = 5)
+    : cacheFile(cacheFile), tuneIterations(tuneIterations) {
+        load();
+    }
+
+    /*
+    Signature of the problem. The stencil function can't be identified from the std::function, so it's
+    given by name.
+    */
+    static std::string problemSignature(int rows, int cols, const std::vector<std::pair<int, int>>& neighborhood, const std::string& kernelName) {
+        std::ostringstream ss;
+        ss << rows << "x" << cols << " nbh";
+        for (auto offset : neighborhood) {
+            ss << " " << offset.first << "," << offset.second;
+        }
+        ss << " " << kernelName << " " << typeid(T).name();
+        return ss.str();
+    }
+
+    //Signature of the machine: the cpu model and the number of hardware threads
+    static std::string hardwareSignature() {
+        std::string model = "unknown";
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.rfind("model name", 0) == 0) {
+                model = line.substr(line.find(':') + 2);
+                break;
+            }
+        }
+        return model + " x" + std::to_string(std::thread::hardware_concurrency());
+    }
+
+    //looks up the configuration of the problem in the cache
+    bool lookup(const std::string& problem, TuningConfig& config) {
+        auto it = cache.find(key(problem));
+        if (it == cache.end()) return false;
+        config = it->second;
+        return true;
+    }
+
+    /*
+    Candidate configurations: the sequential implementation, and every parallel engine of the registry with a
+    number of workers that doubles up to the hardware threads, each with 1 to 16 chunks per worker. The
+    engines that split the matrix in tiles also try bands of whole rows and small square tiles besides the
+    tiles sized to the caches.
+    */
+    std::vector<TuningConfig> candidates() {
+        int hw = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<int> workers;
+        for (int nw = 2; nw < hw; nw *= 2) workers.push_back(nw);
+        if (hw > 1) workers.push_back(hw);
+
+        std::vector<TuningConfig> result;
+        TuningConfig seq;
+        seq.backend = "seq";
+        result.push_back(seq);
+        for (std::string backend : StencilEngineRegistry<T>::instance().names()) {
+            //auto runs the configurations of the cache, it isn't one to tune
+            if (backend == "seq" || backend == "auto") continue;
+            for (int nw : workers) {
+                for (int chunks : {1, 2, 4, 8, 16}) {
+                    TuningConfig c;
+                    c.backend = backend;
+                    c.nworkers = nw;
+                    c.chunksPerWorker = chunks;
+                    result.push_back(c);
+                    if (!StencilEngineRegistry<T>::instance().tiled(backend)) continue;
+                    for (TileShape shape : {TileShape{0, std::numeric_limits<int>::max()}, TileShape{64, 64}}) {
+                        c.tileShape = shape;
+                        result.push_back(c);
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    /*
+    Benchmarks every candidate on the given data, running tuneIterations iterations each, and stores the
+    fastest one in the cache file.
+    */
+    TuningConfig tune(std::function<T(const std::vector<T>&)> stencilFunc, const std::vector<std::pair<int, int>>& neighborhood,
+                      const std::string& kernelName, const std::vector<std::vector<T>>& data) {
+        std::string problem = problemSignature(data.size(), data[0].size(), neighborhood, kernelName);
+        TuningConfig best;
+        bool first = true;
+        for (TuningConfig c : candidates()) {
+            auto start = std::chrono::system_clock::now();
+            run(c, stencilFunc, neighborhood, tuneIterations, data);
+            auto stop = std::chrono::system_clock::now();
+            c.usec = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1.0 / tuneIterations;
+            if (first || c.usec < best.usec) {
+                best = c;
+                first = false;
+            }
+        }
+        cache[key(problem)] = best;
+        save();
+        return best;
+    }
+
+    /*
+    Returns the configuration of the problem, from the cache if it's there, otherwise by tuning it.
+    */
+    TuningConfig configFor(std::function<T(const std::vector<T>&)> stencilFunc, const std::vector<std::pair<int, int>>& neighborhood,
+                           const std::string& kernelName, const std::vector<std::vector<T>>& data) {
+        TuningConfig config;
+        if (lookup(problemSignature(data.size(), data[0].size(), neighborhood, kernelName), config)) return config;
+        return tune(stencilFunc, neighborhood, kernelName, data);
+    }
+
+    //runs the stencil computation with the given configuration
+    static std::vector<std::vector<T>> run(const TuningConfig& config, std::function<T(const std::vector<T>&)> stencilFunc,
+                                           const std::vector<std::pair<int, int>>& neighborhood, int iterations,
+                                           const std::vector<std::vector<T>>& data) {
+        StencilEngineParams<T> params;
+        params.stencilFunc = stencilFunc;
+        params.neighborhood = neighborhood;
+        params.iterations = iterations;
+        params.nworkers = config.nworkers;
+        params.chunksPerWorker = config.chunksPerWorker;
+        params.tileShape = config.tileShape;
+        auto engine = StencilEngineRegistry<T>::instance().create(config.backend, params);
+        if (!engine) engine = StencilEngineRegistry<T>::instance().create("seq", params);
+        return (*engine)(data);
+    }
+
+private:
+    std::string cacheFile;
+    int tuneIterations;
+    std::map<std::string, TuningConfig> cache; //configurations by problem and hardware signature
+
+    std::string key(const std::string& problem) {
+        return problem + "\t" + hardwareSignature();
+    }
+
+    void load() {
+        std::ifstream in(cacheFile);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t second_tab = line.find('\t', line.find('\t') + 1);
+            if (second_tab == std::string::npos) continue;
+            TuningConfig c;
+            std::istringstream values(line.substr(second_tab + 1));
+            if (values >> c.backend >> c.nworkers >> c.chunksPerWorker >> c.usec) {
+                //the entries written before the tiles don't have a tile shape
+                if (!(values >> c.tileShape.rows >> c.tileShape.cols)) c.tileShape = TileShape();
+                cache[line.substr(0, second_tab)] = c;
+            }
+        }
+    }
+
+    //the whole cache is written again, so that the entries of other problems and machines are kept
+    void save() {
+        std::ofstream out(cacheFile);
+        for (auto& entry : cache) {
+            const TuningConfig& c = entry.second;
+            out << entry.first << "\t" << c.backend << " " << c.nworkers << " " << c.chunksPerWorker << " " << c.usec
+                << " " << c.tileShape.rows << " " << c.tileShape.cols << "\n";
+        }
+    }
+};
+
+/*
+Engine that runs the configuration found in the tuning cache for the problem it is given: the backend, the
+workers, the chunks and the tiles of the cache replace the ones of the parameters, and the problem is keyed
+by the size of the matrix, the neighborhood and params.kernelName like in the autotuner. The problems that
+are not in the cache run with the parameters as they are, on the par_threads engine. With a WorkerPool in
+the parameters (the service) the number of workers stays the one of the pool.
+*/
+template<typename T>
+class AutotunedEngine : public StencilEngine<T> {
+public:
+    AutotunedEngine(StencilEngineParams<T> params, std::shared_ptr<StencilAutotuner<T>> tuner)
+    : params(params), tuner(tuner) {}
+
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) override {
+        return (*engineFor(data.size(), data.empty() ? 0 : data[0].size()))(data);
+    }
+
+    int compute(GridView<T> a, GridView<T> b) override {
+        return engineFor(a.rows(), a.cols())->compute(a, b);
+    }
+
+private:
+    StencilEngineParams<T> params;
+    std::shared_ptr<StencilAutotuner<T>> tuner;
+
+    std::unique_ptr<StencilEngine<T>> engineFor(int rows, int cols) {
+        StencilEngineParams<T> p = params;
+        std::string backend = "par_threads";
+        TuningConfig config;
+        if (tuner->lookup(StencilAutotuner<T>::problemSignature(rows, cols, p.neighborhood, p.kernelName), config)) {
+            backend = config.backend;
+            if (!p.pool) p.nworkers = config.nworkers;
+            p.chunksPerWorker = config.chunksPerWorker;
+            p.tileShape = config.tileShape;
+        }
+        auto engine = StencilEngineRegistry<T>::instance().create(backend, p);
+        if (!engine) engine = StencilEngineRegistry<T>::instance().create("seq", p);
+        return engine;
+    }
+};
+
+/*
+Adds the "auto" engine to the registry, reading the configurations from the given tuning cache file (the one
+written by the autotune driver).
+*/
+template<typename T>
+void registerAutotunedEngine(const std::string& cacheFile) {
+    auto tuner = std::make_shared<StencilAutotuner<T>>(cacheFile);
+    StencilEngineRegistry<T>::instance().add("auto", [tuner](const StencilEngineParams<T>& p) -> std::unique_ptr<StencilEngine<T>> {
+        return std::make_unique<AutotunedEngine<T>>(p, tuner);
+    });
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+#ifndef BIT_AUTOMATON_CPP
+#define BIT_AUTOMATON_CPP
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+#include "iteration_runner.cpp"
+#include "tiling.cpp"
+#include "arena.cpp"
+#include "util.h"
+
+/*
+Rule of a binary cellular automaton: the next state of a cell depends on its state and on the number of
+alive cells in its neighborhood. birth[c] says if a dead cell with c alive neighbors becomes alive,
+survive[c] if an alive cell with c alive neighbors stays alive (Game of Life is B3/S23). The tables have an
+entry per count, so the rule can only be used with neighborhoods of at most counts()-1 offsets.
+*/
+struct BitRule {
+    std::vector<bool> birth;
+    std::vector<bool> survive;
+
+    BitRule() {}
+
+    //bit c of the masks is the entry of the count c, for the neighborhoods of up to 31 offsets
+    BitRule(uint32_t birthMask, uint32_t surviveMask) : birth(32), survive(32) {
+        for (int c = 0; c < 32; c++) {
+            birth[c] = birthMask >> c & 1;
+            survive[c] = surviveMask >> c & 1;
+        }
+    }
+
+    //builds the lookup table from a boolean function of (alive, alive neighbors)
+    BitRule(std::function<bool(bool, int)> rule, int neighbors) : birth(neighbors + 1), survive(neighbors + 1) {
+        for (int c = 0; c <= neighbors; c++) {
+            birth[c] = rule(false, c);
+            survive[c] = rule(true, c);
+        }
+    }
+
+    int counts() const { return birth.size(); }
+
+    static BitRule life() { return BitRule(1u << 3, (1u << 2) | (1u << 3)); }
+};
+
+/*
+Matrix of binary cells packed 64 per word: cell (i, j) is bit j%64 of word j/64 of row i. The words are
+stored in an ArenaGrid, so the rows are cache line aligned and the memory comes from the GridArena.
+*/
+class BitGrid {
+public:
+    BitGrid() {}
+    BitGrid(int rows, int cols) : numCols(cols), words(rows, (cols + 63) / 64) {
+        for (int i = 0; i < rows; i++) {
+            std::fill(words[i], words[i] + words.cols(), 0);
+        }
+    }
+
+    //cells different from zero are alive
+    template<typename T>
+    static BitGrid from(const std::vector<std::vector<T>>& data) {
+        BitGrid grid(data.size(), data[0].size());
+        for (int i = 0; i < grid.rows(); i++) {
+            for (int j = 0; j < grid.cols(); j++) {
+                if (data[i][j] != 0) grid.words[i][j / 64] |= 1ull << (j % 64);
+            }
+        }
+        return grid;
+    }
+
+    template<typename T>
+    std::vector<std::vector<T>> toVector() const {
+        std::vector<std::vector<T>> data(rows(), std::vector<T>(cols()));
+        for (int i = 0; i < rows(); i++) {
+            for (int j = 0; j < cols(); j++) {
+                data[i][j] = get(i, j) ? 1 : 0;
+            }
+        }
+        return data;
+    }
+
+    bool get(int i, int j) const { return (words[i][j / 64] >> (j % 64)) & 1; }
+    int rows() const { return words.rows(); }
+    int cols() const { return numCols; }
+    int wordsPerRow() const { return words.cols(); }
+    uint64_t* operator[](int i) { return words[i]; }
+    const uint64_t* operator[](int i) const { return words[i]; }
+
+    void swap(BitGrid& other) {
+        std::swap(numCols, other.numCols);
+        words.swap(other.words);
+    }
+
+private:
+    int numCols = 0;
+    ArenaGrid<uint64_t> words;
+};
+
+/*
+Stencil engine for binary cellular automata on bit packed matrices.
+Instead of building a vector of neighbors per cell and calling the stencil function, 64 cells are updated
+at once: for every offset of the neighborhood the word of the neighbors is built with shifts, and it is
+added to a bit-sliced counter (plane p holds bit p of the count of the 64 cells), with the carries of a
+ripple adder. The rule is then evaluated on the planes with bitwise operations, and the loops over the
+words are plain bitwise code that the compiler can vectorize. The memory is 64 times smaller than with a
+double per cell.
+The neighborhood and the border work like in the other engines: the cells too close to the border for the
+neighborhood are not calculated and keep their value (stencilBounds), and the rows are computed by an
+IterationRunner like the tiles of NewStencilPatternParThreads.
+*/
+class BitAutomatonPattern {
+public:
+    BitAutomatonPattern(BitRule rule, std::vector<std::pair<int, int>> neighborhood, int iterations, int nworkers = 1, int chunksPerWorker = CHUNKS_PER_WORKER)
+    : rule(rule), neighborhood(neighborhood), iterations(iterations), nworkers(nworkers), chunksPerWorker(chunksPerWorker) {
+        if ((int) neighborhood.size() >= this->rule.counts()) {
+            throw std::invalid_argument("the rule doesn't have an entry for every count of the neighborhood");
+        }
+    }
+
+    BitGrid operator()(const BitGrid& data) {
+        BitGrid data1 = data;
+        BitGrid data2 = data;
+        int numRows = data.rows();
+        int numCols = data.cols();
+        int nwords = data.wordsPerRow();
+
+        StencilBounds bounds = stencilBounds(neighborhood, numRows, numCols);
+        int start_row = bounds.start_row, end_row = bounds.end_row;
+        int start_col = bounds.start_col, end_col = bounds.end_col;
+        if (bounds.empty()) return data1;
+
+        //mask of the columns that are calculated, for every word of a row
+        std::vector<uint64_t> interior(nwords, 0);
+        for (int j = start_col; j < end_col; j++) {
+            interior[j / 64] |= 1ull << (j % 64);
+        }
+        //number of bit planes needed to count all the neighbors
+        int planes = 1;
+        while ((1 << planes) <= (int) neighborhood.size()) planes++;
+
+        auto computeRows = [&](int first, int last) {
+            uint64_t count[32];
+            for (int i = first; i < last; i++) {
+                const uint64_t* row = data1[i];
+                uint64_t* out = data2[i];
+                for (int k = 0; k < nwords; k++) {
+                    if (interior[k] == 0) {
+                        out[k] = row[k];
+                        continue;
+                    }
+                    for (int p = 0; p < planes; p++) count[p] = 0;
+                    for (auto offset : neighborhood) {
+                        uint64_t carry = shifted(data1[i + offset.first], k, offset.second, nwords);
+                        for (int p = 0; p < planes && carry; p++) {
+                            uint64_t next = count[p] & carry;
+                            count[p] ^= carry;
+                            carry = next;
+                        }
+                    }
+                    uint64_t alive = row[k];
+                    uint64_t born = 0, survived = 0;
+                    for (int c = 0; c <= (int) neighborhood.size(); c++) {
+                        if (!rule.birth[c] && !rule.survive[c]) continue;
+                        //cells whose count is equal to c
+                        uint64_t equal = ~0ull;
+                        for (int p = 0; p < planes; p++) {
+                            equal &= (c >> p & 1) ? count[p] : ~count[p];
+                        }
+                        if (rule.birth[c]) born |= equal;
+                        if (rule.survive[c]) survived |= equal;
+                    }
+                    uint64_t next = (alive & survived) | (~alive & born);
+                    out[k] = (next & interior[k]) | (alive & ~interior[k]);
+                }
+            }
+        };
+
+        //the rows are the units of the IterationRunner, whose barrier swaps the matrices after every iteration
+        IterationRunner runner(nworkers, chunksPerWorker);
+        runner.run(end_row - start_row, iterations,
+            [&](int, int first, int last) { computeRows(start_row + first, start_row + last); },
+            [&](int) { data1.swap(data2); });
+        return data1;
+    }
+
+private:
+    BitRule rule;
+    std::vector<std::pair<int, int>> neighborhood; //neighborhood offset positions
+    int iterations;
+    int nworkers;
+    int chunksPerWorker;
+
+    /*
+    Word whose bit b is the cell dx columns to the right of bit b of word k (the bits outside of the row
+    are 0).
+    */
+    static uint64_t shifted(const uint64_t* row, int k, int dx, int nwords) {
+        int q = dx >= 0 ? dx / 64 : -((-dx + 63) / 64);
+        int s = dx - q * 64; //0 <= s < 64
+        auto word = [&](int w) -> uint64_t { return (w >= 0 && w < nwords) ? row[w] : 0; };
+        uint64_t low = word(k + q);
+        if (s == 0) return low;
+        return (low >> s) | (word(k + q + 1) << (64 - s));
+    }
+};
+
+#endif
\ No newline at end of file
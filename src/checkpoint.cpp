@@ -0,0 +1,191 @@
+#ifndef CHECKPOINT_CPP
+#define CHECKPOINT_CPP
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "arena.cpp"
+
+/*
+Binary checkpoint file: a fixed header followed by the rows of the matrix.
+The size of the elements is stored so that a checkpoint is not read back with a different type.
+*/
+struct CheckpointHeader {
+    char magic[4]; //"STCK"
+    uint32_t elementSize;
+    int64_t rows;
+    int64_t cols;
+    int64_t iteration; //iterations computed to get to this matrix
+};
+
+/*
+Reads a checkpoint into data. Returns false if the file can't be read or was written for another type.
+*/
+template<typename T>
+bool loadCheckpoint(const std::string& path, std::vector<std::vector<T>>& data, long& iteration) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    CheckpointHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, "STCK", 4) == 0
+        && header.elementSize == sizeof(T) && header.rows > 0 && header.cols > 0;
+    if (ok) {
+        data.assign(header.rows, std::vector<T>(header.cols));
+        for (auto& row : data) {
+            if (fread(row.data(), sizeof(T), row.size(), f) != row.size()) {
+                ok = false;
+                break;
+            }
+        }
+        iteration = header.iteration;
+    }
+    fclose(f);
+    return ok;
+}
+
+/*
+Periodic checkpoints of a stencil computation, written by a background thread.
+The engine calls onSwap() every time it swaps its two matrices. Every `every` iterations the writer takes
+the rows of the matrix that was just computed and writes them to the file (to a temporary file that is
+then renamed, so that the checkpoint on disk is always complete), while the engine goes on.
+The matrix is not copied: during the next iteration the engine only reads it, and at the following swap,
+when the engine would start overwriting it, it is exchanged with a spare matrix that the writer owns
+(copy-on-swap). So the compute only waits if a checkpoint is still being written when the next one is due.
+The time spent in onSwap is accumulated, to measure the overhead of checkpointing on the critical path.
+*/
+template<typename T>
+class CheckpointWriter {
+public:
+    CheckpointWriter(std::string path, int every) : path(path), every(every) {
+        io = std::thread([this]() { writerLoop(); });
+    }
+
+    ~CheckpointWriter() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stop = true;
+        }
+        cv.notify_all();
+        io.join();
+    }
+
+    /*
+    Called by the engine right after swapping the matrices at the end of an iteration: data1 holds the matrix
+    after `completed` iterations, data2 the one that the next iteration is going to overwrite.
+    */
+    void onSwap(GridView<T>& data1, GridView<T>& data2, long completed) {
+        auto start = std::chrono::system_clock::now();
+        std::unique_lock<std::mutex> lock(m);
+        //the matrix being written is about to be overwritten, so the engine gets the spare one instead
+        if (busy && !data2.empty() && data2.data() == pinned[0]) {
+            std::swap(data2, spare);
+        }
+        if (every > 0 && completed % every == 0) {
+            //a checkpoint is still being written, the compute has to wait for it
+            cv.wait(lock, [this]() { return !busy; });
+            if (spare.empty()) {
+                //the spare matrix needs the same border as the others, it's copied once from the stale one
+                spareStorage = ArenaGrid<T>(data2);
+                spare = spareStorage.view();
+            }
+            pinned.clear();
+            for (int i = 0; i < data1.rows(); i++) pinned.push_back(data1[i]);
+            cols = data1.cols();
+            iteration = completed;
+            busy = true;
+            cv.notify_all();
+        }
+        lock.unlock();
+        stallTime += std::chrono::system_clock::now() - start;
+    }
+
+    /*
+    Waits for the checkpoint being written. The engine calls it before returning, since its matrices are
+    released at that point.
+    */
+    void wait() {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [this]() { return !busy; });
+    }
+
+    /*
+    Forgets the spare matrix. After the swaps the spare may be one of the matrices of the engine, and the
+    result of the engine may be in the spare storage, so the engine calls it once it has taken its result.
+    */
+    void release() {
+        std::lock_guard<std::mutex> lock(m);
+        spare = GridView<T>();
+        spareStorage = ArenaGrid<T>();
+    }
+
+    //time spent by the engine in onSwap, in microseconds
+    long overheadMicroseconds() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(stallTime).count();
+    }
+
+    int checkpointsWritten() const { return written; }
+
+    bool failed() const { return writeFailed; }
+
+private:
+    std::string path;
+    int every;
+    std::thread io;
+    std::mutex m;
+    std::condition_variable cv;
+    bool busy = false; //a checkpoint is being written
+    bool stop = false;
+    bool writeFailed = false;
+    std::vector<const T*> pinned; //rows of the matrix being written
+    long cols = 0;
+    long iteration = 0;
+    GridView<T> spare; //matrix given to the engine instead of the one being written
+    ArenaGrid<T> spareStorage; //memory of the spare matrix, allocated at the first checkpoint
+    std::chrono::duration<double> stallTime = std::chrono::duration<double>::zero();
+    int written = 0;
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(m);
+        while (true) {
+            cv.wait(lock, [this]() { return busy || stop; });
+            if (!busy) return;
+            std::vector<const T*> rows = pinned;
+            long numCols = cols;
+            long it = iteration;
+            lock.unlock();
+
+            bool ok = write(rows, numCols, it);
+
+            lock.lock();
+            if (ok) written++;
+            else writeFailed = true;
+            busy = false;
+            cv.notify_all();
+        }
+    }
+
+    bool write(const std::vector<const T*>& rows, long numCols, long it) {
+        std::string tmp = path + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if (!f) return false;
+        CheckpointHeader header;
+        memcpy(header.magic, "STCK", 4);
+        header.elementSize = sizeof(T);
+        header.rows = rows.size();
+        header.cols = numCols;
+        header.iteration = it;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+        for (size_t i = 0; ok && i < rows.size(); i++) {
+            ok = fwrite(rows[i], sizeof(T), numCols, f) == (size_t) numCols;
+        }
+        ok = (fclose(f) == 0) && ok;
+        return ok && rename(tmp.c_str(), path.c_str()) == 0;
+    }
+};
+
+#endif
\ No newline at end of file
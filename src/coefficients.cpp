@@ -0,0 +1,71 @@
+#ifndef COEFFICIENTS_CPP
+#define COEFFICIENTS_CPP
+
+#include <vector>
+#include <stdexcept>
+#include "arena.cpp"
+
+/*
+Read-only coefficient fields of a variable-coefficient stencil (conductivity, wave speed, ...), passed to
+the engines alongside the matrix.
+Every field is stored in its own ArenaGrid (structure of arrays), with the same padded rows as the matrices
+of the engines, so the coefficients of a row are read at the same offsets as its values and stream from
+memory together with them.
+The engines append the coefficients to the vector given to the stencil function: after the value of the cell
+and of its neighbors come, for every field, the coefficient at the cell and at the same neighbors. With m
+offsets in the neighborhood the stencil function gets (m+1) * (1 + number of fields) values.
+*/
+template<typename T>
+class CoefficientFields {
+public:
+    CoefficientFields() {}
+
+    //adds a field, which must have the same size as the matrix (and as the other fields)
+    void add(const std::vector<std::vector<T>>& field) {
+        ArenaGrid<T> grid(field);
+        if (!fields.empty() && (grid.rows() != rows() || grid.cols() != cols())) {
+            throw std::invalid_argument("the coefficient fields must have the same size");
+        }
+        fields.push_back(std::move(grid));
+    }
+
+    int size() const { return fields.size(); }
+    int rows() const { return fields.empty() ? 0 : fields[0].rows(); }
+    int cols() const { return fields.empty() ? 0 : fields[0].cols(); }
+    const ArenaGrid<T>& operator[](int f) const { return fields[f]; }
+
+    //checks that the fields can be used with a matrix of the given size
+    void check(int numRows, int numCols) const {
+        if (!fields.empty() && (rows() != numRows || cols() != numCols)) {
+            throw std::invalid_argument("the coefficient fields don't have the size of the matrix");
+        }
+    }
+
+    //appends the coefficients of every field at (i, j) and at the offsets of the neighborhood
+    void gather(int i, int j, const std::vector<std::pair<int, int>>& neighborhood, std::vector<T>& values) const {
+        for (const auto& field : fields) {
+            values.push_back(field[i][j]);
+            for (const auto& offset : neighborhood) {
+                values.push_back(field[i + offset.first][j + offset.second]);
+            }
+        }
+    }
+
+    /*
+    Row version of gather() for the row kernels: appends, for every field, the pointers to the coefficients of
+    the cells from (i, col0) on and of their neighbors at the offsets of the neighborhood.
+    */
+    void rowPointers(int i, int col0, const std::vector<std::pair<int, int>>& neighborhood, std::vector<const T*>& pointers) const {
+        for (const auto& field : fields) {
+            pointers.push_back(field[i] + col0);
+            for (const auto& offset : neighborhood) {
+                pointers.push_back(field[i + offset.first] + col0 + offset.second);
+            }
+        }
+    }
+
+private:
+    std::vector<ArenaGrid<T>> fields;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+#ifndef GRID_INIT_CPP
+#define GRID_INIT_CPP
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include "parallel_chunks.cpp"
+#include "grid_view.cpp"
+
+/*
+Philox4x32-10 counter-based random number generator (Salmon et al., "Parallel random numbers: as easy as
+1, 2, 3"). The output is a function of a 128 bit counter and a 64 bit key only: there is no state that
+has to be advanced in order, so any cell of the matrix can be generated independently of the others, by
+any thread, and always gets the same value.
+*/
+class Philox4x32 {
+public:
+    static std::array<uint32_t, 4> generate(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+        for (int round = 0; round < 10; round++) {
+            uint64_t product0 = (uint64_t) M0 * counter[0];
+            uint64_t product1 = (uint64_t) M1 * counter[2];
+            counter = {
+                (uint32_t) (product1 >> 32) ^ counter[1] ^ key[0],
+                (uint32_t) product1,
+                (uint32_t) (product0 >> 32) ^ counter[3] ^ key[1],
+                (uint32_t) product0
+            };
+            key[0] += W0;
+            key[1] += W1;
+        }
+        return counter;
+    }
+
+private:
+    static const uint32_t M0 = 0xD2511F53;
+    static const uint32_t M1 = 0xCD9E8D57;
+    static const uint32_t W0 = 0x9E3779B9; //golden ratio
+    static const uint32_t W1 = 0xBB67AE85; //sqrt(3) - 1
+};
+
+/*
+64 random bits for the cell (i, j) of the matrix generated with the given seed. Different streams give
+independent values for the same cell, e.g. for the different fields of a simulation.
+*/
+inline uint64_t philoxRandom(uint64_t seed, uint32_t i, uint32_t j, uint32_t stream = 0) {
+    auto r = Philox4x32::generate({j, i, stream, 0}, {(uint32_t) seed, (uint32_t) (seed >> 32)});
+    return ((uint64_t) r[0] << 32) | r[1];
+}
+
+//uniform value in [0, 1) for the cell (i, j), with the 53 bits of precision of a double
+inline double philoxUniform(uint64_t seed, uint32_t i, uint32_t j, uint32_t stream = 0) {
+    return (philoxRandom(seed, i, j, stream) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+Fills a rows x cols matrix with generator(i, j), in parallel over the rows.
+Every row is allocated by the thread that fills it, so its pages are first touched (and placed on the NUMA
+node of) that thread instead of all being placed by the main thread. The values only depend on (i, j), so
+the matrix is the same for any number of workers.
+*/
+template<typename T, typename Generator>
+std::vector<std::vector<T>> generateGrid(int rows, int cols, Generator generator, int nworkers) {
+    std::vector<std::vector<T>> data(rows);
+    parallelChunks(rows, nworkers, [&](int start, int stop) {
+        for (int i = start; i < stop; i++) {
+            std::vector<T> row(cols);
+            for (int j = 0; j < cols; j++) {
+                row[j] = generator(i, j);
+            }
+            data[i] = std::move(row);
+        }
+    });
+    return data;
+}
+
+/*
+Same as generateGrid, on a matrix owned by the caller (the buffers of a driver or an ArenaGrid): the rows
+are filled by the workers with the same split, so the pages of memory that wasn't written yet are placed by
+the threads that fill them, and the engines that compute on the matrix without copying it find them there.
+*/
+template<typename T, typename Generator>
+void generateInto(GridView<T> data, Generator generator, int nworkers) {
+    parallelChunks(data.rows(), nworkers, [&](int start, int stop) {
+        for (int i = start; i < stop; i++) {
+            T* row = data[i];
+            for (int j = 0; j < data.cols(); j++) {
+                row[j] = generator(i, j);
+            }
+        }
+    });
+}
+
+//integer values in [0, maxValue), like rand() % maxValue
+template<typename T>
+std::vector<std::vector<T>> randomGrid(int rows, int cols, uint64_t seed, int maxValue, int nworkers) {
+    return generateGrid<T>(rows, cols, [=](int i, int j) {
+        return (T) (philoxRandom(seed, i, j) % maxValue);
+    }, nworkers);
+}
+
+//real values uniformly distributed in [low, high)
+template<typename T>
+std::vector<std::vector<T>> uniformGrid(int rows, int cols, uint64_t seed, T low, T high, int nworkers) {
+    return generateGrid<T>(rows, cols, [=](int i, int j) {
+        return (T) (low + (high - low) * philoxUniform(seed, i, j));
+    }, nworkers);
+}
+
+/*
+Analytic initial conditions. The coordinates are x = i / (rows - 1) and y = j / (cols - 1), so that the
+first and last rows and columns are on the border of the unit square.
+*/
+
+//amplitude * sin(kx pi x) * sin(ky pi y), zero on the border for integer kx and ky
+template<typename T>
+std::vector<std::vector<T>> sineGrid(int rows, int cols, T amplitude, int kx, int ky, int nworkers) {
+    double hx = 1.0 / std::max(1, rows - 1);
+    double hy = 1.0 / std::max(1, cols - 1);
+    return generateGrid<T>(rows, cols, [=](int i, int j) {
+        return (T) (amplitude * sin(kx * M_PI * i * hx) * sin(ky * M_PI * j * hy));
+    }, nworkers);
+}
+
+//gaussian bump of the given height and width (standard deviation) centered in (x0, y0)
+template<typename T>
+std::vector<std::vector<T>> gaussianGrid(int rows, int cols, T height, double x0, double y0, double sigma, int nworkers) {
+    double hx = 1.0 / std::max(1, rows - 1);
+    double hy = 1.0 / std::max(1, cols - 1);
+    return generateGrid<T>(rows, cols, [=](int i, int j) {
+        double dx = i * hx - x0;
+        double dy = j * hy - y0;
+        return (T) (height * exp(-(dx * dx + dy * dy) / (2 * sigma * sigma)));
+    }, nworkers);
+}
+
+#endif
\ No newline at end of file
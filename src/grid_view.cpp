@@ -0,0 +1,77 @@
+#ifndef GRID_VIEW_CPP
+#define GRID_VIEW_CPP
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+/*
+Non-owning view of a matrix stored by the caller, row after row, with `stride` elements from one row to the
+next (like a 2D std::mdspan with a strided layout). view[i][j] works like with the vector of vectors.
+Copying a view doesn't copy the matrix, so the engines can swap views like they swap matrices.
+*/
+template<typename T>
+class GridView {
+public:
+    GridView() {}
+    GridView(T* data, int rows, int cols) : GridView(data, rows, cols, cols) {}
+    GridView(T* data, int rows, int cols, size_t stride) : block(data), numRows(rows), numCols(cols), stride(stride) {}
+
+    T* operator[](int i) const { return block + (size_t) i * stride; }
+
+    int rows() const { return numRows; }
+    int cols() const { return numCols; }
+    size_t rowStride() const { return stride; }
+    T* data() const { return block; }
+    bool empty() const { return block == nullptr; }
+
+    std::vector<std::vector<T>> toVector() const {
+        std::vector<std::vector<T>> result(numRows);
+        for (int i = 0; i < numRows; i++) {
+            result[i].assign((*this)[i], (*this)[i] + numCols);
+        }
+        return result;
+    }
+
+private:
+    T* block = nullptr;
+    int numRows = 0;
+    int numCols = 0;
+    size_t stride = 0;
+};
+
+template<typename T>
+void copyGrid(GridView<T> src, GridView<T> dst) {
+    for (int i = 0; i < src.rows(); i++) {
+        std::copy(src[i], src[i] + src.cols(), dst[i]);
+    }
+}
+
+/*
+Copies the cells outside of [start_row, end_row) x [start_col, end_col), which the engines don't calculate,
+so that the scratch matrix given by the caller has the same border as the input.
+*/
+template<typename T>
+void copyBorder(GridView<T> src, GridView<T> dst, int start_row, int end_row, int start_col, int end_col) {
+    for (int i = 0; i < src.rows(); i++) {
+        if (i < start_row || i >= end_row || start_col >= end_col) {
+            std::copy(src[i], src[i] + src.cols(), dst[i]);
+            continue;
+        }
+        std::copy(src[i], src[i] + std::min(start_col, src.cols()), dst[i]);
+        if (end_col < src.cols()) std::copy(src[i] + end_col, src[i] + src.cols(), dst[i] + end_col);
+    }
+}
+
+/*
+Index of the caller's matrix that holds the result of compute(a, b): 0 for a, 1 for b. If the result ended
+up in a matrix of the engine (the spare matrix of a checkpoint), it's copied into b.
+*/
+template<typename T>
+int resultIndex(GridView<T> result, GridView<T> a, GridView<T> b) {
+    if (result.data() == a.data()) return 0;
+    if (result.data() != b.data()) copyGrid(result, b);
+    return 1;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef ITERATION_RUNNER_CPP
+#define ITERATION_RUNNER_CPP
+
+#include <vector>
+#include <thread>
+#include <barrier>
+#include <algorithm>
+#include "new_queue.cpp"
+#include "worker_pool.cpp"
+#include "util.h"
+
+/*
+Runs the iterations of an engine with native threads, the way NewStencilPatternParThreads does it.
+Every iteration computes the units [0, n_units) (tiles, rows, bands, ...), split in about
+nworkers*chunksPerWorker chunks of consecutive units that the workers pop from a ThreadSafeQueue. When all
+the chunks are computed the workers meet at a barrier, whose completion calls onIteration(completed) (where
+the engine swaps its matrices, writes checkpoints, ...) and refills the queue for the next iteration.
+The workers are nworkers-1 new threads plus the calling thread, or the threads of a WorkerPool that is kept
+alive between the runs. With a single worker the iterations run in the calling thread, without the queue and
+the barrier.
+*/
+class IterationRunner {
+public:
+    IterationRunner(int nworkers, int chunksPerWorker = CHUNKS_PER_WORKER)
+    : nworkers(std::max(1, nworkers)), chunksPerWorker(chunksPerWorker) {}
+
+    IterationRunner(WorkerPool& pool, int chunksPerWorker = CHUNKS_PER_WORKER)
+    : nworkers(pool.size()), chunksPerWorker(chunksPerWorker), pool(&pool) {}
+
+    int workers() const { return nworkers; }
+
+    /*
+    body(worker, first, last) computes the units [first, last), worker is the index of the worker in
+    [0, workers()) so that the engine can keep a buffer per worker. onIteration(completed) is called by one
+    thread at a time, after the units of an iteration are computed and before the next iteration starts.
+    */
+    template<typename Body, typename Completion>
+    void run(int n_units, int iterations, Body&& body, Completion&& onIteration) {
+        if (nworkers <= 1) {
+            for (int it = 0; it < iterations; it++) {
+                if (n_units > 0) body(0, 0, n_units);
+                onIteration(it + 1);
+            }
+            return;
+        }
+
+        //push chunks of consecutive units to the queue
+        int number_of_chunks = std::min(n_units, nworkers*chunksPerWorker);
+        ThreadSafeQueue all_chunks;
+        for (int c = 0; c < number_of_chunks; c++) {
+            int start = (long) c*n_units / number_of_chunks;
+            int stop = (long) (c+1)*n_units / number_of_chunks;
+            all_chunks.push(Chunk(start, stop));
+        }
+        ThreadSafeQueue all_chunks_aux = all_chunks;
+
+        int completed = 0; //iterations completed, only touched by the barrier completion
+        auto on_completion = [&]() noexcept {
+            completed++;
+            onIteration(completed);
+            all_chunks_aux = all_chunks;
+        };
+        std::barrier iteration_barrier(nworkers, on_completion);
+
+        auto worker = [&](int id) {
+            for (int it = 0; it < iterations; it++) {
+                Chunk chunk;
+                while (all_chunks_aux.pop(chunk)) {
+                    body(id, chunk.getStart(), chunk.getStop());
+                }
+                iteration_barrier.arrive_and_wait();
+            }
+        };
+
+        if (pool) {
+            pool->run(worker);
+            return;
+        }
+        std::vector<std::thread> threads;
+        for (int id = 1; id < nworkers; id++) {
+            threads.push_back(std::thread(worker, id));
+        }
+        //the calling thread works aswell
+        worker(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    int nworkers;
+    int chunksPerWorker;
+    WorkerPool* pool = nullptr;
+};
+
+#endif
\ No newline at end of file
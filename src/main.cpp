@@ -1,9 +1,12 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include "sequential.cpp"
-#include "new_par_threads.cpp"
-#include "par_fastflow.cpp"
+#include <string>
+#include <sstream>
+#include "stencil_engine.cpp"
+#include "autotuner.cpp"
+#include "grid_init.cpp"
+#include "verify.cpp"
 #include "utimer.h"
 #include "util.h"
 
@@ -11,7 +14,7 @@ using namespace std;
 
 int main(int argc, char* argv[]) {
 	if (argc < 7) {
-		cout << "Wrong usage. Use ./prog seed n nw iterations printMatrix runs" << endl;
+		cout << "Wrong usage. Use ./prog seed n nw iterations printMatrix runs [kernel] [engine,engine,...] [samples] [referenceChecksumFile|-] [save|check] [tuningCacheFile]" << endl;
 		return -1;
 	}
 	int seed = atoi(argv[1]);
@@ -20,20 +23,40 @@ int main(int argc, char* argv[]) {
 	int iterations = atoi(argv[4]);
 	int printMatrix = atoi(argv[5]);
 	int runs = atoi(argv[6]);
+	string kernel = argc > 7 ? argv[7] : "avg";
+	string engineList = argc > 8 ? argv[8] : "seq,par_threads,par_ff,par_ff_wavefront,par_omp";
+	//cells of every result checked against a sequential computation of their dependency cone
+	int samples = argc > 9 ? atoi(argv[9]) : 0;
+	//checksum of a trusted run, that the results are checked against (or that is written, with save)
+	string referenceFile = argc > 10 && string(argv[10]) != "-" ? argv[10] : "";
+	bool saveReference = argc > 11 && string(argv[11]) == "save";
+	//with the cache of the autotune driver, the auto engine runs the configuration tuned for the problem
+	if (argc > 12) registerAutotunedEngine<double>(argv[12]);
 	int lines = n;
 	int columns = n;
 
-	auto function = stencilAvgFunction;
-
-	srand(seed);
-
-	vector<vector<double>> data(lines, vector<double>(columns, 0));
-	for (int i = 0; i < lines; i++) {
-		for (int j = 0; j < columns; j++) {
-			data[i][j] = (double) (rand() % max);
+	auto function = stencilFunctionByName(kernel);
+	if (!function) {
+		cout << "Unknown kernel " << kernel << ", use one of:";
+		for (auto& name : stencilFunctionNames()) cout << " " << name;
+		cout << endl;
+		return -1;
+	}
+	vector<string> engines;
+	stringstream ss(engineList);
+	string name;
+	while (getline(ss, name, ',')) {
+		if (!StencilEngineRegistry<double>::instance().has(name)) {
+			cout << "Unknown engine " << name << ", use one of:";
+			for (auto& engine : StencilEngineRegistry<double>::instance().names()) cout << " " << engine;
+			cout << endl;
+			return -1;
 		}
+		engines.push_back(name);
 	}
 
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, MAX_VALUE, nworkers);
+
 	std::vector<std::pair<int, int>> neighborhood = {
 		pair<int,int>(-1,0),
 		pair<int,int>(1,0),
@@ -41,73 +64,104 @@ int main(int argc, char* argv[]) {
 		pair<int,int>(0,-1)
 	};
 
-	vector<vector<double>> seq;
-	vector<vector<double>> par_threads;
-	vector<vector<double>> par_ff;
-	 //Sequential implementation time
-	{
-		utimer t0("sequential time", runs);
+	StencilEngineParams<double> params;
+	params.stencilFunc = function;
+	params.kernelName = kernel;
+	params.neighborhood = neighborhood;
+	params.iterations = iterations;
+	params.nworkers = nworkers;
+
+	//every engine runs on the same input, and their results are compared with the result of the first one
+	vector<vector<vector<double>>> results(engines.size());
+	for (size_t e = 0; e < engines.size(); e++) {
+		{
+			utimer t0(engines[e] + " time", runs);
 
-		for (int i=0; i<runs; i++) {
-			StencilPatternSeq<double> sp(function, neighborhood, iterations);
-			seq = sp.operator()(data);
+			for (int i=0; i<runs; i++) {
+				auto sp = StencilEngineRegistry<double>::instance().create(engines[e], params);
+				results[e] = (*sp)(data);
+			}
 		}
-	}
-	if (printMatrix) {
-		for (int i = 0; i < lines; i++) {
-			for (int j = 0; j < columns; j++) {
-				cout << seq[i][j] << "  ";
+		/*
+		The same computation on two matrices owned by the driver, which the engine computes into without copies.
+		They are not zero-filled: the input is loaded by the workers (generateInto) and the engine writes the
+		scratch matrix, so their pages are first touched by the workers.
+		*/
+		{
+			ArenaGrid<double> buffer_a(lines, columns), buffer_b(lines, columns);
+			GridView<double> a = buffer_a.view(), b = buffer_b.view();
+			int result = 0;
+			{
+				utimer t0(engines[e] + " zero-copy time", runs);
+
+				for (int i=0; i<runs; i++) {
+					//the input is loaded again, since the engine overwrites it
+					generateInto(a, [&](int r, int c) { return data[r][c]; }, nworkers);
+					auto sp = StencilEngineRegistry<double>::instance().create(engines[e], params);
+					result = sp->compute(a, b);
+				}
+			}
+			if ((result == 0 ? a : b).toVector() != results[e]) {
+				cout << engines[e] << " doesn't output the same matrix with caller-owned buffers" << endl;
+				return -1;
+			}
+		}
+		if (printMatrix) {
+			for (int i = 0; i < lines; i++) {
+				for (int j = 0; j < columns; j++) {
+					cout << results[e][i][j] << "  ";
+				}
+				cout << endl;
 			}
-			cout << endl;
 		}
 	}
-	
 
-	// Parallel implementation time using C++ native threads
-	{
-		utimer t0("parallel time", runs);
+	//memory of the matrices of the engines, which is reused by the runs after the first one
+	ArenaStats stats = GridArena::instance().stats();
+	cout << "arena: " << stats.mappings << " blocks mapped (" << stats.hugeMappings << " with MAP_HUGETLB), "
+		<< stats.reuses << " reused, " << stats.bytesMapped / (1024*1024) << " MB mapped" << endl;
 
-		for (int i=0; i<runs; i++) {
-			NewStencilPatternParThreads<double> sp(function, neighborhood, iterations, nworkers);
-			par_threads = sp(data);
-		}		
-	}
-	if (printMatrix) {
-		for (int i = 0; i < lines; i++) {
-			for (int j = 0; j < columns; j++) {
-				cout << par_threads[i][j] << "  ";
+	//the results are compared in parallel, within a tolerance, since the engines may round differently
+	Tolerance tolerance;
+	for (size_t e = 0; e < engines.size(); e++) {
+		cout << engines[e] << " checksum " << hex << gridChecksum(results[e], nworkers) << dec << endl;
+		if (e > 0) {
+			VerifyReport report = compareGrids(results[0], results[e], tolerance, nworkers);
+			if (!report.ok()) {
+				cout << engines[0] << " and " << engines[e] << " don't output equal matrices: " << report.mismatches
+					<< " cells differ, the first is " << report.row << "," << report.col << endl;
+				return -1;
 			}
-			cout << endl;
 		}
-	}
-
-	//// Parallel implementation time using FastFlow
-	{
-		utimer t0("parallel time fastflow", runs);
-//
-		for (int i=0; i<runs; i++) {
-			StencilPatternParFF<double> sp(function, neighborhood, iterations, nworkers);
-			par_ff = sp(data);
-		}		
-	}
-	if (printMatrix) {
-		for (int i = 0; i < lines; i++) {
-			for (int j = 0; j < columns; j++) {
-				cout << par_ff[i][j] << "  ";
+		if (samples > 0) {
+			VerifyReport report = verifySampled(data, results[e], function, neighborhood, iterations, samples, seed, tolerance, nworkers);
+			if (!report.ok()) {
+				cout << engines[e] << " failed the sampled verification: " << report.mismatches << " of " << report.checked
+					<< " cells differ, the first is " << report.row << "," << report.col << endl;
+				return -1;
 			}
-			cout << endl;
 		}
 	}
-
-	for (int i=0; i<lines; i++) {
-		for (int j=0; j<columns; j++) {
-			if ((seq[i][j] != par_threads[i][j]) || (par_threads[i][j] != par_ff[i][j])) {
-				cout << "The three computations don't output equal matrices" << endl;
-				cout << i << "," << j << endl;
+	if (!referenceFile.empty() && !engines.empty()) {
+		if (saveReference) {
+			if (!saveChecksum(referenceFile, lines, columns, gridChecksum(results[0], nworkers))) {
+				cout << "Can't write the reference checksum to " << referenceFile << endl;
+				return -1;
+			}
+			cout << "The checksum of " << engines[0] << " was saved to " << referenceFile << endl;
+		} else {
+			/*
+			The checksum is exact, and the engines may round differently within the tolerance, so only the first
+			one is checked against the reference: the others were compared with it by compareGrids.
+			*/
+			string error;
+			if (!verifyChecksum(referenceFile, results[0], nworkers, error)) {
+				cout << engines[0] << ": " << error << endl;
 				return -1;
 			}
+			cout << "The results match the reference checksum in " << referenceFile << endl;
 		}
 	}
-	cout << "The three computations output equal matrices\nThe computation was correct" << endl;	
+	cout << "The " << engines.size() << " computations output equal matrices\nThe computation was correct" << endl;
 	return 0;
-}
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <cmath>
+#include "autotuner.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 7) {
+		cout << "Wrong usage. Use ./autotune seed n iterations printMatrix runs cacheFile [retune] [kernel] [neighborhood]" << endl;
+		return -1;
+	}
+	int seed = atoi(argv[1]);
+	int n = atoi(argv[2]);
+	int iterations = atoi(argv[3]);
+	int printMatrix = atoi(argv[4]);
+	int runs = atoi(argv[5]);
+	string cacheFile = argv[6];
+	int retune = argc > 7 ? atoi(argv[7]) : 0;
+	//the configuration is tuned for the kernel and the neighborhood, and bin/prog finds it under the same names
+	string kernel = argc > 8 ? argv[8] : "avg";
+	string neighborhoodName = argc > 9 ? argv[9] : "vonneumann";
+	int lines = n;
+	int columns = n;
+
+	auto function = stencilFunctionByName(kernel);
+	if (!function) {
+		cout << "Unknown kernel " << kernel << ", use one of:";
+		for (auto& name : stencilFunctionNames()) cout << " " << name;
+		cout << endl;
+		return -1;
+	}
+	std::vector<std::pair<int, int>> neighborhood = neighborhoodByName(neighborhoodName);
+	if (neighborhood.empty()) {
+		cout << "Unknown neighborhood " << neighborhoodName << ", use one of:";
+		for (auto& name : neighborhoodNames()) cout << " " << name;
+		cout << endl;
+		return -1;
+	}
+
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, MAX_VALUE, thread::hardware_concurrency());
+
+	StencilAutotuner<double> tuner(cacheFile);
+	TuningConfig config;
+	{
+		utimer t0("tuning time");
+		if (retune) config = tuner.tune(function, neighborhood, kernel, data);
+		else config = tuner.configFor(function, neighborhood, kernel, data);
+	}
+	cout << "configuration: " << config.backend << " nw=" << config.nworkers
+		<< " chunks per worker=" << config.chunksPerWorker << " tiles=" << config.tileShape.rows << "x" << config.tileShape.cols
+		<< " (" << config.usec << " usec per iteration)" << endl;
+
+	vector<vector<double>> result;
+	{
+		utimer t0("tuned time", runs);
+
+		for (int i=0; i<runs; i++) {
+			result = StencilAutotuner<double>::run(config, function, neighborhood, iterations, data);
+		}
+	}
+	if (printMatrix) {
+		for (int i = 0; i < lines; i++) {
+			for (int j = 0; j < columns; j++) {
+				cout << result[i][j] << "  ";
+			}
+			cout << endl;
+		}
+	}
+	return 0;
+}
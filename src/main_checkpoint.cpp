@@ -0,0 +1,95 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <string>
+#include "new_par_threads.cpp"
+#include "checkpoint.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 7) {
+		cout << "Wrong usage. Use ./checkpoint seed n nw iterations every checkpointFile" << endl;
+		return -1;
+	}
+	int seed = atoi(argv[1]);
+	int n = atoi(argv[2]);
+	int nworkers = atoi(argv[3]);
+	int iterations = atoi(argv[4]);
+	int every = atoi(argv[5]);
+	string checkpointFile = argv[6];
+	int lines = n;
+	int columns = n;
+
+	auto function = stencilAvgFunction;
+
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, MAX_VALUE, nworkers);
+
+	std::vector<std::pair<int, int>> neighborhood = {
+		pair<int,int>(-1,0),
+		pair<int,int>(1,0),
+		pair<int,int>(0,1),
+		pair<int,int>(0,-1)
+	};
+
+	vector<vector<double>> reference;
+	vector<vector<double>> checkpointed;
+	vector<vector<double>> resumed;
+	//Run without checkpoints
+	{
+		utimer t0("parallel time without checkpoints");
+		NewStencilPatternParThreads<double> sp(function, neighborhood, iterations, nworkers);
+		reference = sp(data);
+	}
+
+	//Same run, writing a checkpoint every `every` iterations
+	long overhead;
+	int written;
+	{
+		CheckpointWriter<double> writer(checkpointFile, every);
+		{
+			utimer t0("parallel time with checkpoints");
+			NewStencilPatternParThreads<double> sp(function, neighborhood, iterations, nworkers);
+			sp.setCheckpoint(&writer);
+			checkpointed = sp(data);
+		}
+		if (writer.failed()) {
+			cout << "Could not write the checkpoint file " << checkpointFile << endl;
+			return -1;
+		}
+		overhead = writer.overheadMicroseconds();
+		written = writer.checkpointsWritten();
+	}
+	cout << written << " checkpoints written, " << overhead << " usec spent by the compute on checkpointing" << endl;
+
+	//Resume from the last checkpoint and run the remaining iterations
+	long iteration = 0;
+	if (written == 0) {
+		cout << "no checkpoint was written, resuming from the initial matrix" << endl;
+		resumed = data;
+	} else if (!loadCheckpoint(checkpointFile, resumed, iteration)) {
+		cout << "Could not read the checkpoint file " << checkpointFile << endl;
+		return -1;
+	} else {
+		cout << "resuming from iteration " << iteration << endl;
+	}
+	{
+		NewStencilPatternParThreads<double> sp(function, neighborhood, iterations - iteration, nworkers);
+		resumed = sp(resumed);
+	}
+
+	for (int i=0; i<lines; i++) {
+		for (int j=0; j<columns; j++) {
+			if ((reference[i][j] != checkpointed[i][j]) || (reference[i][j] != resumed[i][j])) {
+				cout << "The checkpointed and resumed runs don't output the same matrix" << endl;
+				cout << i << "," << j << endl;
+				return -1;
+			}
+		}
+	}
+	cout << "The checkpointed and resumed runs output the same matrix" << endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <string>
+#include "stencil_service.cpp"
+#include "grid_init.cpp"
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc != 3 && argc < 6) {
+		cout << "Wrong usage. Use ./client socket kernel iterations input output [n [seed]] or ./client socket STATS|SHUTDOWN" << endl;
+		return -1;
+	}
+	string socketPath = argv[1];
+
+	string request;
+	if (argc == 3) {
+		request = argv[2];
+	} else {
+		string kernel = argv[2];
+		int iterations = atoi(argv[3]);
+		string input = argv[4];
+		string output = argv[5];
+		//the input matrix is generated if its size is given, with seed 1 if there isn't one
+		if (argc > 6) {
+			int n = atoi(argv[6]);
+			int seed = argc > 7 ? atoi(argv[7]) : 1;
+			ArenaGrid<double> data(randomGrid<double>(n, n, seed, MAX_VALUE, thread::hardware_concurrency()));
+			string error;
+			if (!writeGrid(input, data, 0, error)) {
+				cout << error << endl;
+				return -1;
+			}
+		}
+		request = "RUN " + kernel + " " + to_string(iterations) + " " + input + " " + output;
+	}
+
+	int fd = connectService(socketPath);
+	if (fd < 0) {
+		cout << "Can't connect to " << socketPath << endl;
+		return -1;
+	}
+	LineSocket connection(fd);
+	string response;
+	auto start = chrono::system_clock::now();
+	if (!connection.writeLine(request) || !connection.readLine(response)) {
+		cout << "The daemon closed the connection" << endl;
+		close(fd);
+		return -1;
+	}
+	long latency = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now() - start).count();
+	close(fd);
+	cout << response << endl;
+	if (response.rfind("OK", 0) != 0) return -1;
+	if (argc > 3) {
+		istringstream fields(response.substr(3));
+		long queue, service;
+		fields >> queue >> service;
+		cout << "queue " << queue << " usec, service " << service << " usec, round trip " << latency << " usec" << endl;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include "stencil_engine.cpp"
+#include "coefficients.cpp"
+#include "row_kernel.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+/*
+Diffusion with a variable conductivity: vec has the cell and its neighbors, then the conductivity at the same
+cells. It assumes exactly one coefficient field, the conductivity, so that vec has twice as many values as the
+neighborhood; that's why it is not selectable by name (stencilFunctionByName) like the functions of util.h,
+whose drivers and service don't give the engines coefficient fields.
+*/
+double stencilVarDiffusionFunction(const vector<double>& vec) {
+	int size = vec.size() / 2;
+	double res = vec[0];
+	for (int i = 1; i < size; i++) {
+		//conductivity of the face between the cell and the neighbor
+		double k = (vec[size] + vec[size + i]) / 2;
+		res += 0.2 * k * (vec[i] - vec[0]);
+	}
+	return res;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 7) {
+		cout << "Wrong usage. Use ./coefficients seed n nw iterations printMatrix runs [engine,engine,...]" << endl;
+		return -1;
+	}
+	int seed = atoi(argv[1]);
+	int n = atoi(argv[2]);
+	int nworkers = atoi(argv[3]);
+	int iterations = atoi(argv[4]);
+	int printMatrix = atoi(argv[5]);
+	int runs = atoi(argv[6]);
+	string engineList = argc > 7 ? argv[7] : "seq,par_threads,par_ff,par_ff_wavefront,par_omp";
+	int lines = n;
+	int columns = n;
+
+	vector<string> engines;
+	stringstream ss(engineList);
+	string name;
+	while (getline(ss, name, ',')) {
+		if (!StencilEngineRegistry<double>::instance().has(name)) {
+			cout << "Unknown engine " << name << endl;
+			return -1;
+		}
+		engines.push_back(name);
+	}
+
+	//heat diffusion on a medium whose conductivity changes from cell to cell
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, MAX_VALUE, nworkers);
+	CoefficientFields<double> coefficients;
+	coefficients.add(uniformGrid<double>(lines, columns, seed + 1, 0.1, 1.0, nworkers));
+
+	std::vector<std::pair<int, int>> neighborhood = {
+		pair<int,int>(-1,0),
+		pair<int,int>(1,0),
+		pair<int,int>(0,1),
+		pair<int,int>(0,-1)
+	};
+
+	StencilEngineParams<double> params;
+	params.stencilFunc = stencilVarDiffusionFunction;
+	params.neighborhood = neighborhood;
+	params.iterations = iterations;
+	params.nworkers = nworkers;
+	params.coefficients = &coefficients;
+
+	//every engine runs on the same input, and their results are compared with the result of the first one
+	vector<vector<vector<double>>> results(engines.size());
+	for (size_t e = 0; e < engines.size(); e++) {
+		{
+			utimer t0(engines[e] + " time", runs);
+
+			for (int i=0; i<runs; i++) {
+				auto sp = StencilEngineRegistry<double>::instance().create(engines[e], params);
+				results[e] = (*sp)(data);
+			}
+		}
+		//the same diffusion with the row kernel, which reads the matrix and the conductivity row by row
+		{
+			StencilEngineParams<double> rowParams = params;
+			rowParams.rowKernel = varDiffusionRows<double>;
+			vector<vector<double>> rowResult;
+			{
+				utimer t0(engines[e] + " row kernel time", runs);
+
+				for (int i=0; i<runs; i++) {
+					auto sp = StencilEngineRegistry<double>::instance().create(engines[e], rowParams);
+					rowResult = (*sp)(data);
+				}
+			}
+			if (rowResult != results[e]) {
+				cout << engines[e] << " doesn't output the same matrix with the row kernel" << endl;
+				return -1;
+			}
+		}
+		if (printMatrix) {
+			for (int i = 0; i < lines; i++) {
+				for (int j = 0; j < columns; j++) {
+					cout << results[e][i][j] << "  ";
+				}
+				cout << endl;
+			}
+		}
+	}
+
+	for (size_t e = 1; e < engines.size(); e++) {
+		if (results[0] != results[e]) {
+			cout << engines[0] << " and " << engines[e] << " don't output equal matrices" << endl;
+			return -1;
+		}
+	}
+	cout << "The " << engines.size() << " computations output equal matrices\nThe computation was correct" << endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <string>
+#include "stencil_service.cpp"
+#include "autotuner.cpp"
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		cout << "Wrong usage. Use ./daemon socket nw [smallJobCells] [prewarmN] [tuningCacheFile]" << endl;
+		return -1;
+	}
+	string socketPath = argv[1];
+	int nworkers = atoi(argv[2]);
+	long smallJobCells = argc > 3 ? atol(argv[3]) : 1 << 18;
+	int prewarmN = argc > 4 ? atoi(argv[4]) : 0;
+
+	StencilService service(socketPath, nworkers, smallJobCells);
+	//the large jobs run the configurations tuned by the autotune driver, when its cache is given
+	if (argc > 5) {
+		registerAutotunedEngine<double>(argv[5]);
+		service.setParallelEngine("auto");
+	}
+	if (prewarmN > 0) {
+		service.prewarm(prewarmN, prewarmN, nworkers);
+	}
+	string error;
+	if (!service.listen(error)) {
+		cout << error << endl;
+		return -1;
+	}
+	cout << "listening on " << socketPath << " with " << nworkers << " workers" << endl;
+	service.serve();
+	cout << "served " << service.jobsServed() << " jobs, " << service.batchesServed() << " batches of small jobs" << endl;
+	return 0;
+}
\ No newline at end of file
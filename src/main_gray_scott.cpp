@@ -0,0 +1,130 @@
+#include <iostream>
+#include <vector>
+#include "multi_field.cpp"
+#include "new_par_threads.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+//parameters of the Gray-Scott reaction-diffusion model
+const double DU = 0.2097, DV = 0.105, FEED = 0.037, KILL = 0.06;
+
+//vec has the cell and its 4 neighbors for the first species, then for the second one
+static double laplacian(const vector<double>& vec, int first) {
+	return vec[first + 1] + vec[first + 2] + vec[first + 3] + vec[first + 4] - 4 * vec[first];
+}
+
+static double grayScottU(const vector<double>& uv) {
+	double u = uv[0], v = uv[5];
+	return u + DU * laplacian(uv, 0) - u * v * v + FEED * (1 - u);
+}
+
+static double grayScottV(const vector<double>& uv) {
+	double u = uv[0], v = uv[5];
+	return v + DV * laplacian(uv, 5) + u * v * v - (FEED + KILL) * v;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 7) {
+		cout << "Wrong usage. Use ./gray_scott seed n nw iterations printMatrix runs" << endl;
+		return -1;
+	}
+	int seed = atoi(argv[1]);
+	int n = atoi(argv[2]);
+	int nworkers = atoi(argv[3]);
+	int iterations = atoi(argv[4]);
+	int printMatrix = atoi(argv[5]);
+	int runs = atoi(argv[6]);
+	int lines = n;
+	int columns = n;
+
+	//u = 1 and v = 0 everywhere, except for a noisy square in the middle where the reaction starts
+	auto seeded = [=](int i, int j) { return abs(i - lines / 2) < lines / 10 && abs(j - columns / 2) < columns / 10; };
+	vector<vector<double>> u = generateGrid<double>(lines, columns, [=](int i, int j) {
+		return seeded(i, j) ? 0.5 + 0.1 * philoxUniform(seed, i, j, 0) : 1.0;
+	}, nworkers);
+	vector<vector<double>> v = generateGrid<double>(lines, columns, [=](int i, int j) {
+		return seeded(i, j) ? 0.25 + 0.1 * philoxUniform(seed, i, j, 1) : 0.0;
+	}, nworkers);
+
+	std::vector<std::pair<int, int>> neighborhood = {
+		pair<int,int>(-1,0),
+		pair<int,int>(1,0),
+		pair<int,int>(0,1),
+		pair<int,int>(0,-1)
+	};
+
+	/*
+	Separate fields: every iteration runs one single-field engine per species, with the other species passed
+	as a coefficient field (the v neighbors come after the u ones for both, so the order is swapped for v).
+	*/
+	vector<vector<double>> u_separate, v_separate;
+	{
+		utimer t0("separate fields time", runs);
+
+		for (int r=0; r<runs; r++) {
+			u_separate = u;
+			v_separate = v;
+			for (int it=0; it<iterations; it++) {
+				CoefficientFields<double> v_field, u_field;
+				v_field.add(v_separate);
+				u_field.add(u_separate);
+				NewStencilPatternParThreads<double> su([](const vector<double>& uv) { return grayScottU(uv); }, neighborhood, 1, nworkers);
+				su.setCoefficients(&v_field);
+				NewStencilPatternParThreads<double> sv([](const vector<double>& vu) {
+					vector<double> uv(vu.begin() + 5, vu.end());
+					uv.insert(uv.end(), vu.begin(), vu.begin() + 5);
+					return grayScottV(uv);
+				}, neighborhood, 1, nworkers);
+				sv.setCoefficients(&u_field);
+				u_separate = su(u_separate);
+				v_separate = sv(v_separate);
+			}
+		}
+	}
+
+	//Coupled fields, updated together in one sweep per iteration
+	MultiFieldFunction<double> grayScott = [](const vector<double>& uv, vector<double>& outputs) {
+		outputs[0] = grayScottU(uv);
+		outputs[1] = grayScottV(uv);
+	};
+	vector<vector<vector<double>>> seq, threads;
+	{
+		utimer t0("coupled fields sequential time", runs);
+
+		for (int r=0; r<runs; r++) {
+			MultiFieldPattern<double> mp(grayScott, neighborhood, iterations);
+			seq = mp({u, v});
+		}
+	}
+	{
+		utimer t0("coupled fields parallel time with native threads", runs);
+
+		for (int r=0; r<runs; r++) {
+			MultiFieldPattern<double> mp(grayScott, neighborhood, iterations, nworkers);
+			threads = mp({u, v});
+		}
+	}
+	if (printMatrix) {
+		for (int i = 0; i < lines; i++) {
+			for (int j = 0; j < columns; j++) {
+				cout << threads[1][i][j] << "  ";
+			}
+			cout << endl;
+		}
+	}
+
+	if (seq[0] != u_separate || seq[1] != v_separate || threads != seq) {
+		cout << "The coupled fields don't output the same matrices as the separate fields" << endl;
+		return -1;
+	}
+	double total_v = 0;
+	for (auto& row : seq[1]) {
+		for (double value : row) total_v += value;
+	}
+	cout << "total v: " << total_v << endl;
+	cout << "The coupled fields output the same matrices as the separate fields" << endl;
+	return 0;
+}
\ No newline at end of file
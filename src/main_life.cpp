@@ -0,0 +1,108 @@
+#include <iostream>
+#include <vector>
+#include "sequential.cpp"
+#include "bit_automaton.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 7) {
+		cout << "Wrong usage. Use ./life seed n nw iterations printMatrix runs [radius]" << endl;
+		return -1;
+	}
+	int seed = atoi(argv[1]);
+	int n = atoi(argv[2]);
+	int nworkers = atoi(argv[3]);
+	int iterations = atoi(argv[4]);
+	int printMatrix = atoi(argv[5]);
+	int runs = atoi(argv[6]);
+	//radius of the Moore neighborhood, 1 is the Game of Life
+	int radius = argc > 7 ? atoi(argv[7]) : 1;
+	int lines = n;
+	int columns = n;
+
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, 2, nworkers);
+
+	//Moore neighborhood
+	std::vector<std::pair<int, int>> neighborhood;
+	for (int dy = -radius; dy <= radius; dy++) {
+		for (int dx = -radius; dx <= radius; dx++) {
+			if (dy != 0 || dx != 0) neighborhood.push_back(pair<int,int>(dy,dx));
+		}
+	}
+
+	//the lookup table of the bit engine is built from the same rule the generic engine applies
+	BitRule rule([](bool alive, int count) {
+		vector<double> vec(count + 1, 1);
+		vec[0] = alive ? 1 : 0;
+		return stencilLifeFunction(vec) != 0;
+	}, neighborhood.size());
+
+	BitGrid bits = BitGrid::from(data);
+	vector<vector<double>> seq;
+	BitGrid bit_seq;
+	BitGrid bit_threads;
+	double updates = (double) lines * columns * iterations * runs;
+	//Generic sequential engine with the Game of Life stencil function
+	{
+		utimer t0("generic sequential time", runs);
+		START(start);
+
+		for (int i=0; i<runs; i++) {
+			StencilPatternSeq<double> sp(stencilLifeFunction, neighborhood, iterations);
+			seq = sp(data);
+		}
+		STOP(start, elapsed);
+		cout << "generic sequential: " << updates / max(elapsed, 1L) << " cell updates per usec" << endl;
+	}
+
+	//Bit packed engine, sequential
+	{
+		utimer t0("bit packed sequential time", runs);
+		START(start);
+
+		for (int i=0; i<runs; i++) {
+			BitAutomatonPattern bp(rule, neighborhood, iterations);
+			bit_seq = bp(bits);
+		}
+		STOP(start, elapsed);
+		cout << "bit packed sequential: " << updates / max(elapsed, 1L) << " cell updates per usec" << endl;
+	}
+
+	//Bit packed engine using C++ native threads
+	{
+		utimer t0("bit packed parallel time with native threads", runs);
+		START(start);
+
+		for (int i=0; i<runs; i++) {
+			BitAutomatonPattern bp(rule, neighborhood, iterations, nworkers);
+			bit_threads = bp(bits);
+		}
+		STOP(start, elapsed);
+		cout << "bit packed parallel: " << updates / max(elapsed, 1L) << " cell updates per usec" << endl;
+	}
+	if (printMatrix) {
+		for (int i = 0; i < lines; i++) {
+			for (int j = 0; j < columns; j++) {
+				cout << bit_threads.get(i, j) << " ";
+			}
+			cout << endl;
+		}
+	}
+
+	for (int i=0; i<lines; i++) {
+		for (int j=0; j<columns; j++) {
+			bool alive = seq[i][j] != 0;
+			if ((alive != bit_seq.get(i, j)) || (alive != bit_threads.get(i, j))) {
+				cout << "The bit packed engine doesn't output the same matrix as the generic engine" << endl;
+				cout << i << "," << j << endl;
+				return -1;
+			}
+		}
+	}
+	cout << "The bit packed engine outputs the same matrix as the generic engine" << endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include "stencil_service.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+//nearest rank percentile of the sorted latencies
+static long percentile(const vector<long>& sorted, double fraction) {
+	if (sorted.empty()) return 0;
+	size_t rank = (size_t) ceil(fraction * sorted.size());
+	return sorted[max(rank, (size_t) 1) - 1];
+}
+
+static void report(const string& name, vector<long> latencies) {
+	sort(latencies.begin(), latencies.end());
+	cout << name << ": p50 " << percentile(latencies, 0.5) << " usec, p99 " << percentile(latencies, 0.99)
+		<< " usec, max " << (latencies.empty() ? 0 : latencies.back()) << " usec" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 6) {
+		cout << "Wrong usage. Use ./loadgen socket clients jobsPerClient n iterations [kernel] [file|shm]" << endl;
+		return -1;
+	}
+	string socketPath = argv[1];
+	int clients = atoi(argv[2]);
+	int jobsPerClient = atoi(argv[3]);
+	int n = atoi(argv[4]);
+	int iterations = atoi(argv[5]);
+	string kernel = argc > 6 ? argv[6] : "avg";
+	bool shm = argc > 7 && string(argv[7]) == "shm";
+
+	//every client has its own input and output matrix
+	vector<string> inputs, outputs;
+	for (int c = 0; c < clients; c++) {
+		string name = "stencil_loadgen_" + to_string(getpid()) + "_" + to_string(c);
+		inputs.push_back(shm ? "shm:/" + name + ".in" : "/tmp/" + name + ".in");
+		outputs.push_back(shm ? "shm:/" + name + ".out" : "/tmp/" + name + ".out");
+		ArenaGrid<double> data(randomGrid<double>(n, n, c, MAX_VALUE, thread::hardware_concurrency()));
+		string error;
+		if (!writeGrid(inputs[c], data, 0, error)) {
+			cout << error << endl;
+			return -1;
+		}
+	}
+
+	//closed loop: every client sends its next job when it gets the response to the previous one
+	vector<vector<long>> roundTrip(clients), queue(clients), service(clients);
+	vector<int> failures(clients, 0);
+	long elapsed;
+	{
+		utimer t0("load generation time");
+		START(start);
+		vector<thread> threads;
+		for (int c = 0; c < clients; c++) {
+			threads.push_back(thread([&, c]() {
+				int fd = connectService(socketPath);
+				if (fd < 0) {
+					failures[c] = jobsPerClient;
+					return;
+				}
+				LineSocket connection(fd);
+				string request = "RUN " + kernel + " " + to_string(iterations) + " " + inputs[c] + " " + outputs[c];
+				for (int j = 0; j < jobsPerClient; j++) {
+					auto sent = chrono::system_clock::now();
+					string response;
+					if (!connection.writeLine(request) || !connection.readLine(response)) {
+						failures[c] += jobsPerClient - j;
+						break;
+					}
+					if (response.rfind("OK", 0) != 0) {
+						failures[c]++;
+						continue;
+					}
+					roundTrip[c].push_back(chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now() - sent).count());
+					istringstream fields(response.substr(3));
+					long q, s;
+					fields >> q >> s;
+					queue[c].push_back(q);
+					service[c].push_back(s);
+				}
+				close(fd);
+			}));
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		STOP(start, usec);
+		elapsed = usec;
+	}
+
+	for (int c = 0; c < clients; c++) {
+		removeGridLocation(inputs[c]);
+		removeGridLocation(outputs[c]);
+	}
+
+	vector<long> allRoundTrip, allQueue, allService;
+	int failed = 0;
+	for (int c = 0; c < clients; c++) {
+		allRoundTrip.insert(allRoundTrip.end(), roundTrip[c].begin(), roundTrip[c].end());
+		allQueue.insert(allQueue.end(), queue[c].begin(), queue[c].end());
+		allService.insert(allService.end(), service[c].begin(), service[c].end());
+		failed += failures[c];
+	}
+	cout << allRoundTrip.size() << " jobs completed, " << failed << " failed, "
+		<< allRoundTrip.size() * 1e6 / max(elapsed, 1L) << " jobs per second" << endl;
+	report("round trip", allRoundTrip);
+	report("queue", allQueue);
+	report("service", allService);
+	return failed == 0 ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <string>
+#include "multigrid.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 6) {
+		cout << "Wrong usage. Use ./multigrid n nw cycle(V|W|FMG) tolerance maxCycles [columns]" << endl;
+		cout << "n and columns must be of the form 2^k+1" << endl;
+		return -1;
+	}
+	int n = atoi(argv[1]);
+	int nworkers = atoi(argv[2]);
+	string cycle = argv[3];
+	double tolerance = atof(argv[4]);
+	int maxCycles = atoi(argv[5]);
+	//the matrix is n x n unless the number of columns is given
+	int columns = argc > 6 ? atoi(argv[6]) : n;
+	if (!MultigridSolver<double>::validSize(n) || !MultigridSolver<double>::validSize(columns)) {
+		cout << "The sizes must be of the form 2^k+1 (for example 129, 513 or 1025) so that the grid can be coarsened" << endl;
+		return -1;
+	}
+
+	MultigridConfig config;
+	if (cycle == "V") config.cycle = MultigridCycle::V;
+	else if (cycle == "W") config.cycle = MultigridCycle::W;
+	else if (cycle == "FMG") config.cycle = MultigridCycle::FMG;
+	else {
+		cout << "Unknown cycle " << cycle << ", use V, W or FMG" << endl;
+		return -1;
+	}
+	config.tolerance = tolerance;
+	config.maxCycles = maxCycles;
+	config.nworkers = nworkers;
+
+	/*
+	Poisson problem on the unit square with the solution sin(pi x) sin(pi y), zero on the border.
+	The initial guess is zero everywhere.
+	*/
+	double hx = 1.0 / (columns - 1);
+	double hy = 1.0 / (n - 1);
+	vector<vector<double>> u0(n, vector<double>(columns, 0));
+	vector<vector<double>> f = sineGrid<double>(n, columns, 2 * M_PI * M_PI, 1, 1, nworkers);
+
+	vector<vector<double>> u;
+	MultigridSolver<double> solver(config);
+	{
+		utimer t0("multigrid time");
+		u = solver(u0, f);
+	}
+
+	const vector<double>& residuals = solver.residuals();
+	cout << "levels: " << solver.numLevels() << ", coarsest grid " << solver.coarsestRows() << "x" << solver.coarsestCols() << endl;
+	for (size_t c = 1; c < residuals.size(); c++) {
+		cout << "cycle " << c << " residual " << residuals[c]
+			<< " (reduced by " << residuals[c] / residuals[c-1] << ")" << endl;
+	}
+	double error = 0;
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < columns; j++) {
+			error = max(error, fabs(u[i][j] - sin(M_PI * i * hy) * sin(M_PI * j * hx)));
+		}
+	}
+	cout << "max error against the exact solution: " << error << endl;
+	return 0;
+}
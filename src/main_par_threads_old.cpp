@@ -28,7 +28,7 @@ int main(int argc, char* argv[]) {
 	vector<vector<double>> data(lines, vector<double>(columns, 0));
 	for (int i = 0; i < lines; i++) {
 		for (int j = 0; j < columns; j++) {
-			data[i][j] = (double) (rand() % max);
+			data[i][j] = (double) (rand() % MAX_VALUE);
 		}
 	}
 
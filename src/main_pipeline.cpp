@@ -0,0 +1,98 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "sequential.cpp"
+#include "stencil_pipeline.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 7) {
+		cout << "Wrong usage. Use ./pipeline seed n nw iterations printMatrix runs" << endl;
+		return -1;
+	}
+	int seed = atoi(argv[1]);
+	int n = atoi(argv[2]);
+	int nworkers = atoi(argv[3]);
+	int iterations = atoi(argv[4]);
+	int printMatrix = atoi(argv[5]);
+	int runs = atoi(argv[6]);
+	int lines = n;
+	int columns = n;
+
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, MAX_VALUE, nworkers);
+
+	std::vector<std::pair<int, int>> neighborhood = {
+		pair<int,int>(-1,0),
+		pair<int,int>(1,0),
+		pair<int,int>(0,1),
+		pair<int,int>(0,-1)
+	};
+
+	//every iteration smooths the matrix and then applies the nonlinear update
+	vector<StencilStage<double>> stages = {
+		{stencilAvgFunction, neighborhood},
+		{stencilSinFunction, {pair<int,int>(0,1)}}
+	};
+
+	vector<vector<double>> unfused;
+	vector<vector<double>> fused_seq;
+	vector<vector<double>> fused_threads;
+	//Unfused pipeline: one full sweep per stage per iteration
+	{
+		utimer t0("unfused sequential time", runs);
+
+		for (int i=0; i<runs; i++) {
+			unfused = data;
+			for (int it=0; it<iterations; it++) {
+				for (auto& stage : stages) {
+					StencilPatternSeq<double> sp(stage.stencilFunc, stage.neighborhood, 1);
+					unfused = sp(unfused);
+				}
+			}
+		}
+	}
+
+	//Fused sequential pipeline
+	{
+		utimer t0("fused sequential time", runs);
+
+		for (int i=0; i<runs; i++) {
+			StencilPipelineSeq<double> sp(stages, iterations);
+			fused_seq = sp(data);
+		}
+	}
+
+	//Fused pipeline using C++ native threads
+	{
+		utimer t0("fused parallel time with native threads", runs);
+
+		for (int i=0; i<runs; i++) {
+			StencilPipelineParThreads<double> sp(stages, iterations, nworkers);
+			fused_threads = sp(data);
+		}
+	}
+	if (printMatrix) {
+		for (int i = 0; i < lines; i++) {
+			for (int j = 0; j < columns; j++) {
+				cout << fused_threads[i][j] << "  ";
+			}
+			cout << endl;
+		}
+	}
+
+	for (int i=0; i<lines; i++) {
+		for (int j=0; j<columns; j++) {
+			if ((unfused[i][j] != fused_seq[i][j]) || (fused_seq[i][j] != fused_threads[i][j])) {
+				cout << "The fused pipelines don't output the same matrix as the unfused stages" << endl;
+				cout << i << "," << j << endl;
+				return -1;
+			}
+		}
+	}
+	cout << "The fused pipelines output the same matrix as the unfused stages" << endl;
+	return 0;
+}
\ No newline at end of file
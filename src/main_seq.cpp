@@ -3,6 +3,7 @@
 #include <cmath>
 #include <thread>
 #include "sequential.cpp"
+#include "grid_init.cpp"
 #include "utimer.h"
 #include "util.h"
 
@@ -10,7 +11,7 @@ using namespace std;
 
 int main(int argc, char* argv[]) {
 	if (argc < 7) {
-		cout << "Wrong usage. Use ./prog seed n nw iterations printMatrix runs" << endl;
+		cout << "Wrong usage. Use ./prog seed n nw iterations printMatrix runs [kernel]" << endl;
 		return -1;
 	}
 	int seed = atoi(argv[1]);
@@ -22,17 +23,14 @@ int main(int argc, char* argv[]) {
 	int lines = n;
 	int columns = n;
 
-	auto function = stencilAvgFunction;
-
-	srand(seed);
-
-	vector<vector<double>> data(lines, vector<double>(columns, 0));
-	for (int i = 0; i < lines; i++) {
-		for (int j = 0; j < columns; j++) {
-			data[i][j] = (double) (rand() % max);
-		}
+	auto function = stencilFunctionByName(argc > 7 ? argv[7] : "avg");
+	if (!function) {
+		cout << "Unknown kernel " << argv[7] << endl;
+		return -1;
 	}
 
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, MAX_VALUE, nworkers);
+
 	std::vector<std::pair<int, int>> neighborhood = {
 		pair<int,int>(-1,0),
 		pair<int,int>(1,0),
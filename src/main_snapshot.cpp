@@ -0,0 +1,58 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <string>
+#include "new_par_threads.cpp"
+#include "snapshot_stream.cpp"
+#include "grid_init.cpp"
+#include "utimer.h"
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 9) {
+		cout << "Wrong usage. Use ./snapshot seed n nw iterations every stride stream|files path [block|drop] [buffers]" << endl;
+		return -1;
+	}
+	int seed = atoi(argv[1]);
+	int n = atoi(argv[2]);
+	int nworkers = atoi(argv[3]);
+	int iterations = atoi(argv[4]);
+	SnapshotConfig config;
+	config.every = atoi(argv[5]);
+	config.stride = atoi(argv[6]);
+	bool fileSequence = string(argv[7]) == "files";
+	string path = argv[8];
+	if (argc > 9 && string(argv[9]) == "drop") config.policy = SnapshotPolicy::Drop;
+	if (argc > 10) config.buffers = atoi(argv[10]);
+	int lines = n;
+	int columns = n;
+
+	auto function = stencilAvgFunction;
+
+	vector<vector<double>> data = randomGrid<double>(lines, columns, seed, MAX_VALUE, nworkers);
+
+	std::vector<std::pair<int, int>> neighborhood = {
+		pair<int,int>(-1,0),
+		pair<int,int>(1,0),
+		pair<int,int>(0,1),
+		pair<int,int>(0,-1)
+	};
+
+	SnapshotStream<double> stream(path, fileSequence, config);
+	{
+		utimer t0("parallel time with snapshots");
+		NewStencilPatternParThreads<double> sp(function, neighborhood, iterations, nworkers);
+		sp.addObserver(&stream);
+		sp(data);
+	}
+	stream.close();
+	if (stream.failed()) {
+		cout << "Could not write the snapshots to " << path << endl;
+		return -1;
+	}
+	cout << stream.framesWritten() << " frames written, " << stream.framesDropped() << " dropped, "
+		<< stream.blockedMicroseconds() << " usec waiting for the writer" << endl;
+	return 0;
+}
\ No newline at end of file
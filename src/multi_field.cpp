@@ -0,0 +1,116 @@
+#ifndef MULTI_FIELD_CPP
+#define MULTI_FIELD_CPP
+
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include "iteration_runner.cpp"
+#include "tiling.cpp"
+#include "arena.cpp"
+#include "coefficients.cpp"
+#include "util.h"
+
+/*
+Stencil function of a coupled system of fields. neighbors has, for every field, the value of the cell and
+of its neighbors (in the order of the neighborhood), the fields one after the other, followed by the
+read-only coefficient fields in the same layout. The function writes the new value of every field of the
+cell in outputs, which has one element per field.
+*/
+template<typename T>
+using MultiFieldFunction = std::function<void(const std::vector<T>& neighbors, std::vector<T>& outputs)>;
+
+/*
+Stencil engine for coupled fields (e.g. the species of a reaction-diffusion system) that are updated
+together from each other's neighborhoods.
+All the fields are computed in the same sweep: every worker gathers the neighborhoods of all the fields of a
+cell and calls the stencil function once for the cell, and there is one barrier per iteration, whose
+completion swaps the two matrices of every field. Running one single-field engine per field would need one
+sweep and one barrier per field per iteration, with the other fields copied in as coefficients.
+Fields that are read but not updated (material properties) are given with setCoefficients().
+The rest works like NewStencilPatternParThreads: the borders are not calculated, and the tiles of the
+matrix are computed by an IterationRunner. With one worker it runs in the calling thread.
+*/
+template<typename T>
+class MultiFieldPattern {
+public:
+    MultiFieldPattern(MultiFieldFunction<T> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nworkers = 1, int chunksPerWorker = CHUNKS_PER_WORKER, TileShape tileShape = TileShape())
+    : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nworkers(nworkers), chunksPerWorker(chunksPerWorker), tileShape(tileShape) {}
+
+    std::vector<std::vector<std::vector<T>>> operator()(const std::vector<std::vector<std::vector<T>>>& fields) {
+        int nfields = fields.size();
+        if (nfields == 0) return fields;
+        //two matrices per field, the first one is read and the second one written by every iteration
+        std::vector<ArenaGrid<T>> data1, data2;
+        for (const auto& field : fields) {
+            data1.emplace_back(field, nworkers);
+            data2.emplace_back(field, nworkers);
+        }
+        int numRows = data1[0].rows();
+        int numCols = data1[0].cols();
+        for (const auto& field : data1) {
+            if (field.rows() != numRows || field.cols() != numCols) {
+                throw std::invalid_argument("the fields must have the same size");
+            }
+        }
+        if (coefficients) coefficients->check(numRows, numCols);
+
+        StencilBounds bounds = stencilBounds(neighborhood, numRows, numCols);
+        std::vector<Tile> tiles = tilesFor<T>(bounds, neighborhood, nworkers*chunksPerWorker, tileShape);
+
+        //computes the tiles [first, last) of all the fields
+        auto computeTiles = [&](int first, int last, std::vector<T>& neighbors, std::vector<T>& outputs) {
+            for (int t = first; t < last; t++) {
+                const Tile& tile = tiles[t];
+                for (int i = tile.row0; i < tile.row1; i++) {
+                    for (int j = tile.col0; j < tile.col1; j++) {
+                        neighbors.clear();
+                        for (int f = 0; f < nfields; f++) {
+                            neighbors.push_back(data1[f][i][j]);
+                            for (const auto& offset : neighborhood) {
+                                neighbors.push_back(data1[f][i + offset.first][j + offset.second]);
+                            }
+                        }
+                        if (coefficients) coefficients->gather(i, j, neighborhood, neighbors);
+                        stencilFunc(neighbors, outputs);
+                        for (int f = 0; f < nfields; f++) {
+                            data2[f][i][j] = outputs[f];
+                        }
+                    }
+                }
+            }
+        };
+
+        //a single barrier per iteration for all the fields, whose completion swaps all of them
+        IterationRunner runner(nworkers, chunksPerWorker);
+        std::vector<std::vector<T>> neighbors(runner.workers()), outputs(runner.workers(), std::vector<T>(nfields));
+        for (auto& vec : neighbors) vec.reserve((neighborhood.size() + 1) * (nfields + (coefficients ? coefficients->size() : 0)));
+        runner.run(tiles.size(), iterations,
+            [&](int worker, int first, int last) { computeTiles(first, last, neighbors[worker], outputs[worker]); },
+            [&](int) {
+                for (int f = 0; f < nfields; f++) std::swap(data1[f], data2[f]);
+            });
+        return toVectors(data1);
+    }
+
+    //read-only fields, appended to the neighbors of the updated fields
+    void setCoefficients(const CoefficientFields<T>* fields) {
+        coefficients = fields;
+    }
+
+private:
+    MultiFieldFunction<T> stencilFunc;
+    std::vector<std::pair<int, int>> neighborhood; //neighborhood offset positions
+    int iterations;
+    int nworkers;
+    int chunksPerWorker; //number of chunks the tiles are split in, per worker
+    TileShape tileShape; //size of the tiles, chosen from the cache sizes where it is 0
+    const CoefficientFields<T>* coefficients = nullptr;
+
+    static std::vector<std::vector<std::vector<T>>> toVectors(const std::vector<ArenaGrid<T>>& grids) {
+        std::vector<std::vector<std::vector<T>>> result;
+        for (const auto& grid : grids) result.push_back(grid.toVector());
+        return result;
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,278 @@
+#ifndef MULTIGRID_CPP
+#define MULTIGRID_CPP
+
+#include <vector>
+#include <functional>
+#include <cmath>
+#include <mutex>
+#include <memory>
+#include <stdexcept>
+#include "parallel_chunks.cpp"
+
+/*
+Cycle schedules of the multigrid solver.
+V and W cycles visit the coarse grids once and twice per level, FMG (full multigrid) starts by solving on
+the coarsest grid and interpolates the solution up, doing one V cycle on every level, before the V cycles
+on the finest grid.
+*/
+enum class MultigridCycle { V, W, FMG };
+
+struct MultigridConfig {
+    MultigridCycle cycle = MultigridCycle::V;
+    int preSmooth = 2; //Jacobi sweeps before going to the coarse grid
+    int postSmooth = 2; //Jacobi sweeps after the coarse grid correction
+    double omega = 0.8; //weight of the Jacobi sweeps (4/5 is the best smoother for the 5-point laplacian)
+    int coarseSweeps = 50; //sweeps on the coarsest grid (one is enough if it has a single unknown)
+    int maxCycles = 50;
+    double tolerance = 1e-8; //residual target, relative to the residual of the initial guess
+    int nworkers = 1;
+};
+
+/*
+Geometric multigrid solver for the Poisson equation -laplacian(u) = f on the unit square, discretized with
+the 5-point stencil (the von Neumann neighborhood used by the drivers).
+The grid is a (rows x columns) matrix like the ones of the StencilPattern classes, and in the same way
+the border of the matrix is not calculated: it holds the Dirichlet boundary values. The fixed-iteration
+Jacobi sweeps of the stencil engines need O(n^2) iterations to converge, while every cycle here reduces
+the residual by a constant factor, independent of the grid size.
+The levels are built by halving the grid while (rows-1) and (columns-1) are even, so the rows and the
+columns must both be of the form 2^k+1, and the coarsest grid has 3 rows or 3 columns. Other sizes would
+stop the coarsening early, leaving the cycles as plain Jacobi sweeps on a large grid, so they are rejected. The spacings hx and hy are the ones of the unit square, so they
+differ when the matrix isn't square. The equation is still solved then, but the Jacobi sweeps smooth the
+error less along the direction with the larger spacing, so the cycles reduce the residual by less.
+The smoothing is a weighted Jacobi sweep: every cell is computed from its neighbors into a second matrix
+and the matrices are swapped, like one iteration of the stencil engines, split in chunks between the
+workers. The stencil function of the engines only sees the neighbor values, so it can't be given the
+right hand side of each coarse grid, that's why the sweep is written here. The threads are taken from a
+WorkerPool created once per solve, since a cycle does many short sweeps on every level.
+*/
+template<typename T>
+class MultigridSolver {
+public:
+    MultigridSolver(MultigridConfig config) : config(config) {}
+
+    /*
+    Solves the equation with right hand side f, starting from the initial guess u (whose border is the
+    boundary condition). Returns the solution, the residual norm after every cycle is in residuals().
+    */
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& u0, const std::vector<std::vector<T>>& f) {
+        if (u0.empty() || !validSize(u0.size()) || !validSize(u0[0].size())) {
+            throw std::invalid_argument("the rows and the columns of the multigrid matrix must be 2^k+1");
+        }
+        buildLevels(u0.size(), u0[0].size());
+        if (config.nworkers > 1) pool = std::make_unique<WorkerPool>(config.nworkers);
+        levels[0].u = u0;
+        levels[0].f = f;
+        residualHistory.clear();
+
+        double initial = residual(0);
+        residualHistory.push_back(initial);
+        double target = config.tolerance * initial;
+
+        if (config.cycle == MultigridCycle::FMG) {
+            fullMultigrid();
+            residualHistory.push_back(residual(0));
+        }
+        while ((int) residualHistory.size() <= config.maxCycles && residualHistory.back() > target) {
+            cycle(0, config.cycle == MultigridCycle::W ? 2 : 1);
+            residualHistory.push_back(residual(0));
+        }
+        pool.reset();
+        return levels[0].u;
+    }
+
+    //L2 norm of the residual of the initial guess and after every cycle
+    const std::vector<double>& residuals() const { return residualHistory; }
+
+    int numLevels() const { return levels.size(); }
+
+    //size of the coarsest grid, where the error equation is solved with coarseSweeps Jacobi sweeps
+    int coarsestRows() const { return levels.back().rows; }
+    int coarsestCols() const { return levels.back().cols; }
+
+    //sizes that coarsen down to 3: 3, 5, 9, 17, ...
+    static bool validSize(int n) {
+        return n >= 3 && ((n - 1) & (n - 2)) == 0;
+    }
+
+private:
+    struct Level {
+        int rows, cols;
+        double hx, hy; //grid spacing between the columns and between the rows
+        std::vector<std::vector<T>> u, f, r, tmp;
+    };
+
+    MultigridConfig config;
+    std::vector<Level> levels;
+    std::vector<double> residualHistory;
+    std::unique_ptr<WorkerPool> pool; //alive for the duration of a solve
+
+    void buildLevels(int rows, int cols) {
+        levels.clear();
+        double hx = 1.0 / (cols - 1);
+        double hy = 1.0 / (rows - 1);
+        while (true) {
+            Level l;
+            l.rows = rows;
+            l.cols = cols;
+            l.hx = hx;
+            l.hy = hy;
+            l.u.assign(rows, std::vector<T>(cols, 0));
+            l.f = l.u;
+            l.r = l.u;
+            l.tmp = l.u;
+            levels.push_back(std::move(l));
+            if (rows <= 3 || cols <= 3 || (rows-1) % 2 != 0 || (cols-1) % 2 != 0) break;
+            rows = (rows-1) / 2 + 1;
+            cols = (cols-1) / 2 + 1;
+            hx *= 2;
+            hy *= 2;
+        }
+    }
+
+    //small grids are not worth waking up the threads for
+    void forChunks(const Level& l, int n_indexes, std::function<void(int, int)> body) {
+        if (!pool || l.rows * l.cols < 4096) parallelChunks(n_indexes, 1, body);
+        else parallelChunks(n_indexes, *pool, body);
+    }
+
+    /*
+    Runs the given function on every interior cell of the level, split in chunks between the workers
+    (same index calculation as the stencil engines).
+    */
+    void forInterior(const Level& l, std::function<void(int, int)> cell) {
+        int cols = l.cols - 2;
+        int n_indexes = (l.rows - 2) * cols;
+        forChunks(l, n_indexes, [&](int start, int stop) {
+            for (int index = start; index < stop; index++) {
+                cell(index / cols + 1, index % cols + 1);
+            }
+        });
+    }
+
+    //weighted Jacobi sweeps on level k
+    void smooth(int k, int sweeps) {
+        Level& l = levels[k];
+        //weights of the horizontal and vertical neighbors, 1/hx^2 and 1/hy^2
+        double ax = 1.0 / (l.hx * l.hx);
+        double ay = 1.0 / (l.hy * l.hy);
+        double diagonal = 2 * ax + 2 * ay;
+        double omega = config.omega;
+        //the border of tmp has to hold the boundary values aswell, since the matrices are swapped
+        for (int j = 0; j < l.cols; j++) {
+            l.tmp[0][j] = l.u[0][j];
+            l.tmp[l.rows-1][j] = l.u[l.rows-1][j];
+        }
+        for (int i = 0; i < l.rows; i++) {
+            l.tmp[i][0] = l.u[i][0];
+            l.tmp[i][l.cols-1] = l.u[i][l.cols-1];
+        }
+        for (int s = 0; s < sweeps; s++) {
+            forInterior(l, [&](int i, int j) {
+                T jacobi = (ay * (l.u[i-1][j] + l.u[i+1][j]) + ax * (l.u[i][j-1] + l.u[i][j+1]) + l.f[i][j]) / diagonal;
+                l.tmp[i][j] = (1 - omega) * l.u[i][j] + omega * jacobi;
+            });
+            std::swap(l.u, l.tmp);
+        }
+    }
+
+    //computes r = f - A u on level k and returns its L2 norm
+    double residual(int k) {
+        Level& l = levels[k];
+        double ax = 1.0 / (l.hx * l.hx);
+        double ay = 1.0 / (l.hy * l.hy);
+        double sum = 0;
+        std::mutex m;
+        int cols = l.cols - 2;
+        forChunks(l, (l.rows - 2) * cols, [&](int start, int stop) {
+            double partial = 0;
+            for (int index = start; index < stop; index++) {
+                int i = index / cols + 1;
+                int j = index % cols + 1;
+                T au = ay * (2 * l.u[i][j] - l.u[i-1][j] - l.u[i+1][j]) + ax * (2 * l.u[i][j] - l.u[i][j-1] - l.u[i][j+1]);
+                l.r[i][j] = l.f[i][j] - au;
+                partial += l.r[i][j] * l.r[i][j];
+            }
+            std::lock_guard<std::mutex> lock(m);
+            sum += partial;
+        });
+        return std::sqrt(sum);
+    }
+
+    //full weighting restriction of the fine matrix into the interior of the coarse one
+    void restrictTo(const std::vector<std::vector<T>>& src, Level& coarse, std::vector<std::vector<T>>& dst) {
+        forInterior(coarse, [&](int I, int J) {
+            int i = 2*I, j = 2*J;
+            dst[I][J] = (4 * src[i][j]
+                + 2 * (src[i-1][j] + src[i+1][j] + src[i][j-1] + src[i][j+1])
+                + src[i-1][j-1] + src[i-1][j+1] + src[i+1][j-1] + src[i+1][j+1]) / 16;
+        });
+    }
+
+    //bilinear interpolation of the coarse matrix, added to the interior of the fine one
+    void prolongAdd(const std::vector<std::vector<T>>& src, Level& fine, std::vector<std::vector<T>>& dst) {
+        forInterior(fine, [&](int i, int j) {
+            int I = i / 2, J = j / 2;
+            T value;
+            if (i % 2 == 0 && j % 2 == 0) value = src[I][J];
+            else if (i % 2 == 0) value = (src[I][J] + src[I][J+1]) / 2;
+            else if (j % 2 == 0) value = (src[I][J] + src[I+1][J]) / 2;
+            else value = (src[I][J] + src[I][J+1] + src[I+1][J] + src[I+1][J+1]) / 4;
+            dst[i][j] += value;
+        });
+    }
+
+    /*
+    One cycle on level k: pre-smoothing, restriction of the residual, gamma recursive cycles on the error
+    equation of the coarse grid (zero boundary, zero initial guess), correction and post-smoothing.
+    */
+    void cycle(int k, int gamma) {
+        if (k == (int) levels.size() - 1) {
+            smooth(k, config.coarseSweeps);
+            return;
+        }
+        smooth(k, config.preSmooth);
+        residual(k);
+        Level& coarse = levels[k+1];
+        for (auto& row : coarse.u) std::fill(row.begin(), row.end(), 0);
+        for (auto& row : coarse.f) std::fill(row.begin(), row.end(), 0);
+        restrictTo(levels[k].r, coarse, coarse.f);
+        for (int g = 0; g < gamma; g++) {
+            cycle(k+1, gamma);
+        }
+        prolongAdd(coarse.u, levels[k], levels[k].u);
+        smooth(k, config.postSmooth);
+    }
+
+    /*
+    Full multigrid: the right hand side and the boundary are brought down to every level, the coarsest one
+    is solved, and the solution is interpolated to the next level as its initial guess, where a V cycle is
+    done, up to the finest grid.
+    */
+    void fullMultigrid() {
+        int last = levels.size() - 1;
+        for (int k = 0; k < last; k++) {
+            Level& fine = levels[k];
+            Level& coarse = levels[k+1];
+            for (auto& row : coarse.f) std::fill(row.begin(), row.end(), 0);
+            restrictTo(fine.f, coarse, coarse.f);
+            for (int I = 0; I < coarse.rows; I++) {
+                for (int J = 0; J < coarse.cols; J++) {
+                    coarse.u[I][J] = (I == 0 || J == 0 || I == coarse.rows-1 || J == coarse.cols-1) ? fine.u[2*I][2*J] : 0;
+                }
+            }
+        }
+        smooth(last, config.coarseSweeps);
+        for (int k = last-1; k >= 0; k--) {
+            Level& fine = levels[k];
+            //the boundary of the fine level is kept, the interior is interpolated from the coarse solution
+            for (int i = 1; i < fine.rows-1; i++) {
+                std::fill(fine.u[i].begin() + 1, fine.u[i].end() - 1, 0);
+            }
+            prolongAdd(levels[k+1].u, fine, fine.u);
+            cycle(k, 1);
+        }
+    }
+};
+
+#endif
\ No newline at end of file
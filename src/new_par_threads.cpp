@@ -1,158 +1,162 @@
+#ifndef NEW_PAR_THREADS_CPP
+#define NEW_PAR_THREADS_CPP
+
 #include <vector>
 #include <functional>
-#include <thread>
-#include <barrier>
 #include <iostream>
-#include "new_queue.cpp"
-
-#define CHUNKS_PER_WORKER 4
+#include "iteration_runner.cpp"
+#include "tiling.cpp"
+#include "util.h"
+#include "arena.cpp"
+#include "checkpoint.cpp"
+#include "stencil_observer.cpp"
+#include "coefficients.cpp"
+#include "row_kernel.cpp"
 
 using namespace std;
 
 template<typename T>
 class NewStencilPatternParThreads {
 public:
-    NewStencilPatternParThreads(std::function<T(std::vector<T>)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nworkers)
-        : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nworkers(nworkers) {}
+    NewStencilPatternParThreads(std::function<T(const std::vector<T>&)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nworkers, int chunksPerWorker = CHUNKS_PER_WORKER, TileShape tileShape = TileShape())
+        : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nworkers(nworkers), chunksPerWorker(chunksPerWorker), tileShape(tileShape) {}
 
-    std::vector<std::vector<T>> operator()(std::vector<std::vector<T>> data) {
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) {
         /*
         Here we make two copies of the input stencil matrix. We don't want to change the input data, therefore we
         make two copies of it.
         The idea is to write the output of the stencil function into the data2 matrix, and after every matrix has
         calculated the output, the data1 and data2 matrices are swapped (std::swap). This method wastes twice the
         memory, but is the fastest way to do the calculations, while remaining thread safe. 
+        The matrices are stored in blocks of the GridArena, which are reused by the next runs.
         */
-        std::vector<std::vector<T>> data1 = data;
-        std::vector<std::vector<T>> data2 = data1;
-        int numRows = data1.size();
-        int numCols = data1[0].size();
-
-        /*
-        This section of the code calculates the starting and ending lines and columns, given that the borders of
-        the stencil matrix are not supposed to be calculated. It iterates through the neighborhood input vector
-        and stores the maximum offset of each axis.
-        */
-        int max_y_offset = 0, max_x_offset = 0, min_y_offset = 0, min_x_offset = 0;
-        for (auto offset : neighborhood) {
-            int y_offset = offset.first;
-            int x_offset = offset.second;
-
-            if (y_offset > max_y_offset) max_y_offset = y_offset;
-            if (y_offset < min_y_offset) min_y_offset = y_offset;
-
-            if (x_offset > max_x_offset) max_x_offset = x_offset;
-            if (x_offset < min_x_offset) min_x_offset = x_offset;
-        }
+        ArenaGrid<T> data1(data, nworkers);
+        //only the border of the second matrix is read, and compute() copies it
+        ArenaGrid<T> data2(data1.rows(), data1.cols());
+        int result = compute(data1.view(), data2.view());
+        return result == 0 ? data1.toVector() : data2.toVector();
+    }
 
-        //calculation of the start and end row and column
-        int start_row = -min_y_offset, end_row = numRows - max_y_offset;
-        int start_col = -min_x_offset, end_col = numCols - max_x_offset;
+    /*
+    Computes the iterations on matrices owned by the caller, without copying them: a holds the input and b is
+    a scratch matrix of the same size (its border is copied from a). Both are overwritten, and the return
+    value tells which one holds the result (0 for a, 1 for b).
+    */
+    int compute(GridView<T> a, GridView<T> b) {
+        GridView<T> data1 = a;
+        GridView<T> data2 = b;
+        int numRows = a.rows();
+        int numCols = a.cols();
+        if (coefficients) coefficients->check(numRows, numCols);
 
         /*
-        Here we calculate the total number of rows, columns, and the total number of indexes to process.
+        The borders of the stencil matrix are not supposed to be calculated: the rows and columns that are
+        calculated are the ones farther from the border than the reach of the neighborhood.
         */
-        int rows = end_row - start_row; //number of rows to process
-        int cols = end_col - start_col; //number of columns to process
-        int n_indexes = rows * cols; //number of total indexes to process
-        int number_of_chunks = nworkers*CHUNKS_PER_WORKER;
-
-        int chunk_size = n_indexes / number_of_chunks;
-
-        // we create the vector of threads so that we can join them later
-        std::vector<std::thread> threads;
-        // we create the queue that will allow us to process the tasks in parallel thread safely
-        ThreadSafeQueue all_chunks;
-
-
-        //push chunks to the queue
-        for (int c=0; c<number_of_chunks; c++) {
-            //push all the chunks to the thread access safe queue
-            int start = c*chunk_size;
-            int stop = (c+1)*chunk_size;
-            if (c==number_of_chunks-1) stop = n_indexes;
-            Chunk currentChunk(start,stop);
-            all_chunks.push(currentChunk);
-        }
-        ThreadSafeQueue all_chunks_aux = all_chunks;
-
-        // at this point, all_chunks_aux is reset to all the chunks
-        auto on_completion = [&]() {
-            std::swap(data1, data2);
-            all_chunks_aux = all_chunks;
-        };
+        StencilBounds bounds = stencilBounds(neighborhood, numRows, numCols);
+        copyBorder(a, b, bounds.start_row, bounds.end_row, bounds.start_col, bounds.end_col);
+
         /*
-        Definition of the barrier.
-        The barrier happens after all threads made the computation of all tasks of the queue. This is needed
-        so that we can swap the matrices and fill the task queue. This is done with the on_completion
-        function that is called after all threads have been gathered by the barrier
+        The rows and columns to process are split in 2D tiles sized to the caches (see tileShapeFor), so that
+        for wide matrices and large neighborhoods the rows read by a worker are still in cache when the next
+        rows of the tile need them.
         */
-        std::barrier b(nworkers, on_completion);
+        IterationRunner runner = pool ? IterationRunner(*pool, chunksPerWorker) : IterationRunner(nworkers, chunksPerWorker);
+        std::vector<Tile> tiles = tilesFor<T>(bounds, neighborhood, runner.workers()*chunksPerWorker, tileShape);
 
         /*
-        Code of each worker thread
-        Every thread pops tasks from the queue (thread safely), and processes the result of the
-        stencil function.
+        The IterationRunner hands out chunks of consecutive tiles to the threads through a ThreadSafeQueue, and
+        syncs them on a barrier after every iteration. The completion of the barrier swaps the matrices, so
+        that the next iteration builds upon the previous one.
         */
-        auto worker = [&]() {
-
-            for (int it = 0; it < iterations; it++) {
-                /*
-                While the queue is not empty, a task is popped, and the result of the stencil function is placed
-                in the buffer matrix
-                */
-                Chunk chunk;
-                while(all_chunks_aux.pop(chunk)) {
-                    int start = chunk.getStart();
-                    int end = chunk.getStop();
-                    for (int index=start; index<end; index++) {
-                        int line = index / cols + start_row; //calculate the line index
-                        int column = index % cols + start_col; //calculate the column index
-                        //define the neighbor vector
-                        std::vector<T> neighbors;
+        //vector of neighbors of every thread, reused for every cell so that it is only allocated once
+        std::vector<std::vector<T>> neighbors(runner.workers());
+        for (auto& vec : neighbors) vec.reserve(neighborhood.size() + 1);
+        //row pointers of every thread, for the row kernel
+        std::vector<std::vector<const T*>> pointers(runner.workers());
+
+        auto computeTiles = [&](int worker, int first, int last) {
+            std::vector<T>& cell_neighbors = neighbors[worker];
+            for (int t=first; t<last; t++) {
+                const Tile& tile = tiles[t];
+                for (int line=tile.row0; line<tile.row1; line++) {
+                    if (rowKernel) {
+                        applyRowKernel(rowKernel, neighborhood, coefficients, data1, data2, line, tile.col0, tile.col1, pointers[worker]);
+                        continue;
+                    }
+                    for (int column=tile.col0; column<tile.col1; column++) {
+                        //empty the neighbor vector
+                        cell_neighbors.clear();
                         //push the current index
-                        neighbors.push_back(data1[line][column]); //insert current element in neighbors vec
+                        cell_neighbors.push_back(data1[line][column]); //insert current element in neighbors vec
                         //push all the neighbors
                         for (auto offset : neighborhood) {
                             int ni = line + offset.first;
                             int nj = column + offset.second;
-                            neighbors.push_back(data1[ni][nj]); //insert current neighbor in neighbors vec
+                            cell_neighbors.push_back(data1[ni][nj]); //insert current neighbor in neighbors vec
                         }
+                        //push the coefficients, if any
+                        if (coefficients) coefficients->gather(line, column, neighborhood, cell_neighbors);
                         //The result of the stencil function is placed in the buffer matrix
-                        data2[line][column] = stencilFunc(neighbors);
+                        data2[line][column] = stencilFunc(cell_neighbors);
                     }
                 }
-
-                /*
-                Barrier syncs the threads after they have computed the chunks
-                It waits for all computations to be done, so that the next iteration
-                can build upon the previous one, by swapping the matrices
-                */
-                b.arrive_and_wait();
             }
         };
+        auto on_iteration = [&](int completed) {
+            std::swap(data1, data2);
+            if (checkpoint) checkpoint->onSwap(data1, data2, completed);
+            for (auto observer : observers) observer->onIteration(data1, completed);
+        };
+        runner.run(tiles.size(), iterations, computeTiles, on_iteration);
+
+        //the checkpoint being written may still be reading one of the matrices
+        if (checkpoint) checkpoint->wait();
+
+        //returns which matrix holds the final values
+        int result = resultIndex(data1, a, b);
+        if (checkpoint) checkpoint->release();
+        return result;
+    }
 
-        //launches the threads to do the work
-        for (int i = 0; i < nworkers-1; i++) {
-            threads.push_back(std::thread(worker));
-        }
-        //and puts the main execution to work aswell, so that no thread goes to waste!
-        worker();
+    //writes a checkpoint of the matrix periodically while the iterations run
+    void setCheckpoint(CheckpointWriter<T>* writer) {
+        checkpoint = writer;
+    }
+
+    //the observer is called with the matrix computed at the end of every iteration
+    void addObserver(StencilObserver<T>* observer) {
+        observers.push_back(observer);
+    }
 
-        //destroys all the threads that were launched
-        for (auto& thread : threads) {
-            thread.join();
-        }
+    //read-only coefficient fields, appended to the neighbors given to the stencil function
+    void setCoefficients(const CoefficientFields<T>* fields) {
+        coefficients = fields;
+    }
+
+    //stencil function applied to whole rows, used instead of the stencil function if it is set
+    void setRowKernel(RowKernel<T> kernel) {
+        rowKernel = kernel;
+    }
 
-        //returns final matrix
-        return data1;
+    //runs on the threads of the pool, which are kept alive between the runs, instead of nworkers new threads
+    void setWorkerPool(WorkerPool* workers) {
+        pool = workers;
     }
 
-    
 
 private:
-    std::function<T(std::vector<T>)> stencilFunc; //stencil function to be applied on each neighborhood vector
+    std::function<T(const std::vector<T>&)> stencilFunc; //stencil function to be applied on each neighborhood vector
     std::vector<std::pair<int, int>> neighborhood; //neighborhood offset positions
     int iterations;
     int nworkers;
-};
\ No newline at end of file
+    int chunksPerWorker; //number of chunks the tiles are split in, per worker
+    TileShape tileShape; //size of the tiles, chosen from the cache sizes where it is 0
+    CheckpointWriter<T>* checkpoint = nullptr;
+    const CoefficientFields<T>* coefficients = nullptr;
+    RowKernel<T> rowKernel;
+    WorkerPool* pool = nullptr;
+    std::vector<StencilObserver<T>*> observers;
+};
+
+#endif
\ No newline at end of file
@@ -1,3 +1,6 @@
+#ifndef NEW_QUEUE_CPP
+#define NEW_QUEUE_CPP
+
 #include <mutex>
 #include <queue>
 #include <iostream>
@@ -64,4 +67,6 @@ public:
         q = copy.q;
         return *this;
     }
-};
\ No newline at end of file
+};
+
+#endif
\ No newline at end of file
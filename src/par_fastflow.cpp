@@ -1,3 +1,6 @@
+#ifndef PAR_FASTFLOW_CPP
+#define PAR_FASTFLOW_CPP
+
 #include <iostream>
 #include <cmath>
 #include <vector>
@@ -6,8 +9,11 @@
 #include <ff/parallel_for.hpp>
 #include <ff/barrier.hpp>
 #include <functional>
-
-#define CHUNKS_PER_WORKER 4
+#include "util.h"
+#include "arena.cpp"
+#include "tiling.cpp"
+#include "coefficients.cpp"
+#include "row_kernel.cpp"
 
 using namespace ff;
 using namespace std;
@@ -15,75 +21,110 @@ using namespace std;
 template<typename T>
 class StencilPatternParFF {
 private:
-    std::function<T(std::vector<T>)> stencilFunc;
+    std::function<T(const std::vector<T>&)> stencilFunc;
     std::vector<std::pair<int, int>> neighborhood;
     int iterations;
     int nw;
+    int chunksPerWorker; //the tiles are handed out in about nw*chunksPerWorker chunks
+    TileShape tileShape; //size of the tiles, chosen from the cache sizes where it is 0
+    const CoefficientFields<T>* coefficients = nullptr;
+    RowKernel<T> rowKernel;
 public:
-    StencilPatternParFF(std::function<T(std::vector<T>)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nw)
-    : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nw(nw) {}
+    StencilPatternParFF(std::function<T(const std::vector<T>&)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nw, int chunksPerWorker = CHUNKS_PER_WORKER, TileShape tileShape = TileShape())
+    : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nw(nw), chunksPerWorker(chunksPerWorker), tileShape(tileShape) {}
 
-    std::vector<std::vector<T>> operator()(std::vector<std::vector<T>> data) { //capture data by reference
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) {
         /*
         Here we make two copies of the input stencil matrix. We don't want to change the input data, therefore we
         make two copies of it.
         The idea is to write the output of the stencil function into the data2 matrix, and after every matrix has
         calculated the output, the data1 and data2 matrices are swapped (std::swap). This method wastes twice the
         memory, but is the fastest way to do the calculations, while remaining thread safe. 
+        The matrices are stored in blocks of the GridArena, which are reused by the next runs.
         */
-        std::vector<std::vector<T>> data1 = data;
-        vector<vector<T>> data2 = data1; //copies the 2d matrix?
-        int numRows = data1.size();
-        int numCols = data1[0].size();
+        ArenaGrid<T> data1(data, nw);
+        //only the border of the second matrix is read, and compute() copies it
+        ArenaGrid<T> data2(data1.rows(), data1.cols());
+        int result = compute(data1.view(), data2.view());
+        return result == 0 ? data1.toVector() : data2.toVector();
+    }
+
+    /*
+    Computes the iterations on matrices owned by the caller, without copying them: a holds the input and b is
+    a scratch matrix of the same size (its border is copied from a). Both are overwritten, and the return
+    value tells which one holds the result (0 for a, 1 for b).
+    */
+    int compute(GridView<T> a, GridView<T> b) {
+        GridView<T> data1 = a;
+        GridView<T> data2 = b;
+        int numRows = a.rows();
+        int numCols = a.cols();
+        if (coefficients) coefficients->check(numRows, numCols);
         /*
-        This section of the code calculates the starting and ending lines and columns, given that the borders of
-        the stencil matrix are not supposed to be calculated. It iterates through the neighborhood input vector
-        and stores the maximum offset of each axis.
+        The borders of the stencil matrix are not supposed to be calculated: only the rows and columns farther
+        from the border than the reach of the neighborhood are.
         */
-        int max_y_offset = 0, max_x_offset = 0, min_y_offset = 0, min_x_offset = 0;
-        for (auto offset : neighborhood) {
-            int y_offset = offset.first;
-            int x_offset = offset.second;
-            if (y_offset > max_y_offset) max_y_offset = y_offset;
-            if (y_offset < min_y_offset) min_y_offset = y_offset;
-            if (x_offset > max_x_offset) max_x_offset = x_offset;
-            if (x_offset < min_x_offset) min_x_offset = x_offset;
-        }
-        //calculation of the start and end row and column
-        int start_row = -min_y_offset, end_row = numRows - max_y_offset;
-        int start_col = -min_x_offset, end_col = numCols - max_x_offset;
+        StencilBounds bounds = stencilBounds(neighborhood, numRows, numCols);
+        int start_row = bounds.start_row, end_row = bounds.end_row;
+        int start_col = bounds.start_col, end_col = bounds.end_col;
+        copyBorder(a, b, start_row, end_row, start_col, end_col);
         /*
-        Here we calculate the total number of rows, columns, and the total number of indexes to process.
+        Here we calculate the total number of rows and columns to process, and split them in 2D tiles sized to
+        the caches, like in NewStencilPatternParThreads.
         */
-        int rows = end_row - start_row; //number of rows to process
-        int cols = end_col - start_col; //number of columns to process
-        int n_indexes = rows * cols; //number of total indexes to process
+        std::vector<Tile> tiles = tilesFor<T>(bounds, neighborhood, nw*chunksPerWorker, tileShape);
+        int n_tiles = tiles.size(); //number of total tiles to process
+        long grain = n_tiles / (nw*chunksPerWorker);
+        if (grain < 1) grain = 1;
         //Creates the ParallelFor FastFlow block, with nw workers.
         ParallelFor pf(nw, true);
         /*
-        In every iteration, a parallel for is ran on all indexes, with dynamic scheduling, so that every thread
+        In every iteration, a parallel for is ran on all tiles, with dynamic scheduling, so that every thread
         is working while the queue isnt empty
         */
         for (int i=0; i<iterations; i++) {
-            pf.parallel_for(0, n_indexes, 1, nw*CHUNKS_PER_WORKER, [&](int index) {
-                int line = index / cols + start_row; //calculate the line index
-                int column = index % cols + start_col; //calculate the column index
-                //define the neighbor vector
-                std::vector<T> neighbors;
-                //push the current index
-                neighbors.push_back(data1[line][column]); //insert current element in neighbors vec
-                //push all the neighbors
-                for (auto offset : neighborhood) {
-                    int ni = line + offset.first;
-                    int nj = column + offset.second;
-                    neighbors.push_back(data1[ni][nj]); //insert current neighbor in neighbors vec
+            pf.parallel_for(0, n_tiles, 1, grain, [&](int t) {
+                const Tile& tile = tiles[t];
+                //neighbor vector of the worker thread, only allocated once per thread
+                thread_local std::vector<T> neighbors;
+                thread_local std::vector<const T*> pointers;
+                for (int line=tile.row0; line<tile.row1; line++) {
+                    if (rowKernel) {
+                        applyRowKernel(rowKernel, neighborhood, coefficients, data1, data2, line, tile.col0, tile.col1, pointers);
+                        continue;
+                    }
+                    for (int column=tile.col0; column<tile.col1; column++) {
+                        neighbors.clear();
+                        //push the current index
+                        neighbors.push_back(data1[line][column]); //insert current element in neighbors vec
+                        //push all the neighbors
+                        for (auto offset : neighborhood) {
+                            int ni = line + offset.first;
+                            int nj = column + offset.second;
+                            neighbors.push_back(data1[ni][nj]); //insert current neighbor in neighbors vec
+                        }
+                        //push the coefficients, if any
+                        if (coefficients) coefficients->gather(line, column, neighborhood, neighbors);
+                        //The result of the stencil function is placed in the buffer matrix
+                        data2[line][column] = stencilFunc(neighbors);
+                    }
                 }
-                //The result of the stencil function is placed in the buffer matrix
-                data2[line][column] = stencilFunc(neighbors);
             }, nw);
             //matrices are swapped so that the next iteration can build upon the previous one
             std::swap(data1, data2);
         }
-        return data1;
+        return resultIndex(data1, a, b);
     }
-};
\ No newline at end of file
+
+    //read-only coefficient fields, appended to the neighbors given to the stencil function
+    void setCoefficients(const CoefficientFields<T>* fields) {
+        coefficients = fields;
+    }
+
+    //stencil function applied to whole rows, used instead of the stencil function if it is set
+    void setRowKernel(RowKernel<T> kernel) {
+        rowKernel = kernel;
+    }
+};
+
+#endif
\ No newline at end of file
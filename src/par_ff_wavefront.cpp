@@ -0,0 +1,213 @@
+#ifndef PAR_FF_WAVEFRONT_CPP
+#define PAR_FF_WAVEFRONT_CPP
+
+#include <vector>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <ff/ff.hpp>
+#include <ff/farm.hpp>
+#include "util.h"
+#include "arena.cpp"
+#include "tiling.cpp"
+#include "coefficients.cpp"
+#include "row_kernel.cpp"
+
+using namespace ff;
+
+/*
+Task of the wavefront: compute the rows of a band for one iteration.
+*/
+struct BandTask {
+    int band;
+    int iteration; //the band is computed from the matrix after this many iterations
+};
+
+/*
+Stencil implementation with a FastFlow farm whose tasks are row bands, with a feedback channel from the
+workers back to the emitter.
+StencilPatternParFF runs a parallel_for per iteration, so every iteration ends with a global barrier and the
+workers idle while the last indexes of the iteration are computed. Here there is no barrier: the emitter
+keeps track of the iterations completed by every band, and band b starts iteration k+1 as soon as the bands
+it reads from (b-1, b and b+1 when the bands are at least as tall as the neighborhood) completed iteration
+k. The bands at the top of the matrix can then run ahead of the ones at the bottom, and the iterations
+overlap in a wavefront.
+Two matrices are enough: iteration k reads buffer k%2 and writes buffer (k+1)%2. When band b writes
+iteration k+1 it overwrites its own values of iteration k-1, which were only read by the same bands it
+waits for.
+*/
+template<typename T>
+class StencilPatternParFFWavefront {
+private:
+    std::function<T(const std::vector<T>&)> stencilFunc;
+    std::vector<std::pair<int, int>> neighborhood;
+    int iterations;
+    int nw;
+    int chunksPerWorker; //bands per worker, if the band height is not given
+    int bandRows; //rows per band, 0 to pick it from the number of workers
+    const CoefficientFields<T>* coefficients = nullptr;
+    RowKernel<T> rowKernel;
+
+    /*
+    The emitter sends the first iteration of all the bands, and every time a band comes back from a worker it
+    sends the next iteration of the bands around it that became ready.
+    */
+    struct Emitter : ff_monode_t<BandTask> {
+        int nbands, iterations, radius;
+        std::vector<BandTask> tasks; //one task per band, a band is never in flight twice
+        std::vector<int> done; //iterations completed by each band
+        std::vector<bool> inflight;
+        long remaining;
+
+        Emitter(int nbands, int iterations, int radius)
+        : nbands(nbands), iterations(iterations), radius(radius), tasks(nbands), done(nbands, 0),
+          inflight(nbands, false), remaining((long) nbands * iterations) {}
+
+        //sends the next iteration of band b, if the bands it reads from are not behind it
+        void trySend(int b) {
+            if (inflight[b] || done[b] == iterations) return;
+            for (int c = std::max(0, b - radius); c <= std::min(nbands - 1, b + radius); c++) {
+                if (done[c] < done[b]) return;
+            }
+            inflight[b] = true;
+            tasks[b].band = b;
+            tasks[b].iteration = done[b];
+            this->ff_send_out(&tasks[b]);
+        }
+
+        BandTask* svc(BandTask* task) {
+            if (task == nullptr) {
+                if (remaining == 0) return this->EOS;
+                for (int b = 0; b < nbands; b++) trySend(b);
+                return this->GO_ON;
+            }
+            int b = task->band;
+            inflight[b] = false;
+            done[b]++;
+            if (--remaining == 0) return this->EOS;
+            for (int c = std::max(0, b - radius); c <= std::min(nbands - 1, b + radius); c++) {
+                trySend(c);
+            }
+            return this->GO_ON;
+        }
+    };
+
+    struct Worker : ff_node_t<BandTask> {
+        StencilPatternParFFWavefront* sp;
+        GridView<T>* buffers;
+        int start_row, end_row, start_col, end_col, band_rows;
+        std::vector<T> neighbors; //neighbor vector of the worker, reused for every cell
+        std::vector<const T*> pointers; //row pointers of the worker, for the row kernel
+
+        BandTask* svc(BandTask* task) {
+            GridView<T> data1 = buffers[task->iteration % 2];
+            GridView<T> data2 = buffers[(task->iteration + 1) % 2];
+            int first = start_row + task->band * band_rows;
+            int last = std::min(end_row, first + band_rows);
+            for (int line = first; line < last; line++) {
+                if (sp->rowKernel) {
+                    applyRowKernel(sp->rowKernel, sp->neighborhood, sp->coefficients, data1, data2, line, start_col, end_col, pointers);
+                    continue;
+                }
+                for (int column = start_col; column < end_col; column++) {
+                    //empty the neighbor vector
+                    neighbors.clear();
+                    //push the current index
+                    neighbors.push_back(data1[line][column]);
+                    //push all the neighbors
+                    for (auto offset : sp->neighborhood) {
+                        neighbors.push_back(data1[line + offset.first][column + offset.second]);
+                    }
+                    //push the coefficients, if any
+                    if (sp->coefficients) sp->coefficients->gather(line, column, sp->neighborhood, neighbors);
+                    //The result of the stencil function is placed in the buffer matrix
+                    data2[line][column] = sp->stencilFunc(neighbors);
+                }
+            }
+            //the task goes back to the emitter through the feedback channel
+            return task;
+        }
+    };
+
+public:
+    StencilPatternParFFWavefront(std::function<T(const std::vector<T>&)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nw, int chunksPerWorker = CHUNKS_PER_WORKER, int bandRows = 0)
+    : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nw(nw), chunksPerWorker(chunksPerWorker), bandRows(bandRows) {}
+
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) {
+        ArenaGrid<T> data1(data, nw);
+        //only the border of the second matrix is read, and compute() copies it
+        ArenaGrid<T> data2(data1.rows(), data1.cols());
+        int result = compute(data1.view(), data2.view());
+        return result == 0 ? data1.toVector() : data2.toVector();
+    }
+
+    /*
+    Computes the iterations on matrices owned by the caller, without copying them: a holds the input and b is
+    a scratch matrix of the same size (its border is copied from a). Both are overwritten, and the return
+    value tells which one holds the result (0 for a, 1 for b).
+    */
+    int compute(GridView<T> a, GridView<T> b) {
+        GridView<T> buffers[2] = {a, b};
+        int numRows = a.rows();
+        int numCols = a.cols();
+        if (coefficients) coefficients->check(numRows, numCols);
+        /*
+        The borders of the stencil matrix are not supposed to be calculated: only the rows and columns farther
+        from the border than the reach of the neighborhood are.
+        */
+        StencilBounds bounds = stencilBounds(neighborhood, numRows, numCols);
+        int start_row = bounds.start_row, end_row = bounds.end_row;
+        int start_col = bounds.start_col, end_col = bounds.end_col;
+        int rows = end_row - start_row; //number of rows to process
+        copyBorder(a, b, start_row, end_row, start_col, end_col);
+        if (rows <= 0 || end_col <= start_col || iterations <= 0) return 0;
+
+        int band_rows = bandRows;
+        if (band_rows <= 0) band_rows = (rows + nw*chunksPerWorker - 1) / (nw*chunksPerWorker);
+        if (band_rows < 1) band_rows = 1;
+        int nbands = (rows + band_rows - 1) / band_rows;
+        //number of bands above and below a band that its neighborhood reaches
+        NeighborhoodReach offsets = neighborhoodReach(neighborhood);
+        int reach = std::max(offsets.max_y, -offsets.min_y);
+        int radius = (reach + band_rows - 1) / band_rows;
+
+        Emitter emitter(nbands, iterations, radius);
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<ff_node*> nodes;
+        for (int i = 0; i < nw; i++) {
+            auto w = std::make_unique<Worker>();
+            w->sp = this;
+            w->buffers = buffers;
+            w->start_row = start_row;
+            w->end_row = end_row;
+            w->start_col = start_col;
+            w->end_col = end_col;
+            w->band_rows = band_rows;
+            nodes.push_back(w.get());
+            workers.push_back(std::move(w));
+        }
+
+        ff_farm farm;
+        farm.add_emitter(&emitter);
+        farm.add_workers(nodes);
+        farm.remove_collector();
+        farm.wrap_around();
+        //the bands go to the first free worker, since the bands that are ready don't come in a fixed order
+        farm.set_scheduling_ondemand();
+        farm.run_and_wait_end();
+
+        return iterations % 2;
+    }
+
+    //read-only coefficient fields, appended to the neighbors given to the stencil function
+    void setCoefficients(const CoefficientFields<T>* fields) {
+        coefficients = fields;
+    }
+
+    //stencil function applied to whole rows, used instead of the stencil function if it is set
+    void setRowKernel(RowKernel<T> kernel) {
+        rowKernel = kernel;
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef PAR_OPENMP_CPP
+#define PAR_OPENMP_CPP
+
+#include <vector>
+#include <functional>
+#include <omp.h>
+#include "util.h"
+#include "arena.cpp"
+#include "tiling.cpp"
+#include "coefficients.cpp"
+#include "row_kernel.cpp"
+
+template<typename T>
+class StencilPatternParOMP {
+public:
+    StencilPatternParOMP(std::function<T(const std::vector<T>&)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nworkers, int chunksPerWorker = CHUNKS_PER_WORKER, TileShape tileShape = TileShape())
+    : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nworkers(nworkers), chunksPerWorker(chunksPerWorker), tileShape(tileShape) {}
+
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) {
+        /*
+        Same two matrices as the other implementations: the output of the stencil function is written into
+        data2, and the matrices are swapped at the end of every iteration. The matrices are stored in blocks of the
+        GridArena, which are reused by the next runs.
+        */
+        ArenaGrid<T> data1(data, nworkers);
+        //only the border of the second matrix is read, and compute() copies it
+        ArenaGrid<T> data2(data1.rows(), data1.cols());
+        int result = compute(data1.view(), data2.view());
+        return result == 0 ? data1.toVector() : data2.toVector();
+    }
+
+    /*
+    Computes the iterations on matrices owned by the caller, without copying them: a holds the input and b is
+    a scratch matrix of the same size (its border is copied from a). Both are overwritten, and the return
+    value tells which one holds the result (0 for a, 1 for b).
+    */
+    int compute(GridView<T> a, GridView<T> b) {
+        GridView<T> data1 = a;
+        GridView<T> data2 = b;
+        int numRows = a.rows();
+        int numCols = a.cols();
+        if (coefficients) coefficients->check(numRows, numCols);
+        /*
+        The borders of the stencil matrix are not supposed to be calculated: only the rows and columns farther
+        from the border than the reach of the neighborhood are.
+        */
+        StencilBounds bounds = stencilBounds(neighborhood, numRows, numCols);
+        int start_row = bounds.start_row, end_row = bounds.end_row;
+        int start_col = bounds.start_col, end_col = bounds.end_col;
+        copyBorder(a, b, start_row, end_row, start_col, end_col);
+        /*
+        The rows and columns are split in 2D tiles sized to the caches, like in NewStencilPatternParThreads, and
+        the tiles are handed out dynamically by the OpenMP runtime, in chunks of consecutive tiles so that there are
+        about nworkers*chunksPerWorker chunks.
+        */
+        std::vector<Tile> tiles = tilesFor<T>(bounds, neighborhood, nworkers*chunksPerWorker, tileShape);
+        int n_tiles = tiles.size();
+        int chunk_size = n_tiles / (nworkers*chunksPerWorker);
+        if (chunk_size < 1) chunk_size = 1;
+
+        /*
+        The parallel region is opened once for all the iterations, so that the threads are not created again
+        on every iteration.
+        The implicit barrier at the end of the for loop waits for all the tiles to be computed, and one of
+        the threads swaps the matrices (the single construct also ends with an implicit barrier).
+        */
+        #pragma omp parallel num_threads(nworkers)
+        {
+            //vector of neighbors of this thread, reused for every cell so that it is only allocated once
+            std::vector<T> neighbors;
+            neighbors.reserve(neighborhood.size() + 1);
+            //row pointers of this thread, for the row kernel
+            std::vector<const T*> pointers;
+            for (int iter = 0; iter < iterations; ++iter) {
+                #pragma omp for schedule(dynamic, chunk_size)
+                for (int t = 0; t < n_tiles; ++t) {
+                    const Tile& tile = tiles[t];
+                    for (int i = tile.row0; i < tile.row1; ++i) {
+                        if (rowKernel) {
+                            applyRowKernel(rowKernel, neighborhood, coefficients, data1, data2, i, tile.col0, tile.col1, pointers);
+                            continue;
+                        }
+                        for (int j = tile.col0; j < tile.col1; ++j) {
+                            //vector of neighbors is emptied
+                            neighbors.clear();
+                            //the current item is taken into account
+                            neighbors.push_back(data1[i][j]);
+                            //every neighbor is added to the vector of neighbors
+                            for (const auto& offset : neighborhood) {
+                                neighbors.push_back(data1[i + offset.first][j + offset.second]);
+                            }
+                            if (coefficients) coefficients->gather(i, j, neighborhood, neighbors);
+                            //the result of the stencil function is stored in the buffer matrix
+                            data2[i][j] = stencilFunc(neighbors);
+                        }
+                    }
+                }
+                #pragma omp single
+                std::swap(data1, data2);
+            }
+        }
+        return resultIndex(data1, a, b);
+    }
+
+    //read-only coefficient fields, appended to the neighbors given to the stencil function
+    void setCoefficients(const CoefficientFields<T>* fields) {
+        coefficients = fields;
+    }
+
+    //stencil function applied to whole rows, used instead of the stencil function if it is set
+    void setRowKernel(RowKernel<T> kernel) {
+        rowKernel = kernel;
+    }
+private:
+    std::function<T(const std::vector<T>&)> stencilFunc; //stencil function to be applied on each neighborhood vector
+    std::vector<std::pair<int, int>> neighborhood; //neighborhood offset positions
+    int iterations;
+    int nworkers;
+    int chunksPerWorker; //number of chunks the tiles are split in, per worker
+    TileShape tileShape; //size of the tiles, chosen from the cache sizes where it is 0
+    const CoefficientFields<T>* coefficients = nullptr;
+    RowKernel<T> rowKernel;
+};
+
+#endif
\ No newline at end of file
@@ -14,7 +14,7 @@ public:
     StencilPatternParThreads(std::function<T(std::vector<T>)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations, int nworkers)
         : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations), nworkers(nworkers) {}
 
-    std::vector<std::vector<T>> operator()(std::vector<std::vector<T>> data) {
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) {
         /*
         Here we make two copies of the input stencil matrix. We don't want to change the input data, therefore we
         make two copies of it.
@@ -0,0 +1,80 @@
+#ifndef PARALLEL_CHUNKS_CPP
+#define PARALLEL_CHUNKS_CPP
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include "new_queue.cpp"
+#include "worker_pool.cpp"
+#include "util.h"
+
+//splits [0, n_indexes) in about nworkers*chunksPerWorker chunks
+inline void pushChunks(ThreadSafeQueue& all_chunks, int n_indexes, int nworkers, int chunksPerWorker) {
+    int number_of_chunks = nworkers*chunksPerWorker;
+    if (number_of_chunks > n_indexes) number_of_chunks = n_indexes;
+    int chunk_size = n_indexes / number_of_chunks;
+
+    for (int c=0; c<number_of_chunks; c++) {
+        int start = c*chunk_size;
+        int stop = (c+1)*chunk_size;
+        if (c==number_of_chunks-1) stop = n_indexes;
+        all_chunks.push(Chunk(start, stop));
+    }
+}
+
+/*
+Runs body(start, stop) over the indexes [0, n_indexes) with nworkers threads.
+The indexes are split in chunks that are pushed to a ThreadSafeQueue and popped by the workers until the
+queue is empty, in the same way NewStencilPatternParThreads processes one iteration. The calling thread
+works aswell. It is meant for the single sweeps (restriction, residuals, ...) that don't need to keep the
+threads alive between them.
+*/
+inline void parallelChunks(int n_indexes, int nworkers, std::function<void(int, int)> body,
+                           int chunksPerWorker = CHUNKS_PER_WORKER) {
+    if (n_indexes <= 0) return;
+    if (nworkers <= 1) {
+        body(0, n_indexes);
+        return;
+    }
+    ThreadSafeQueue all_chunks;
+    pushChunks(all_chunks, n_indexes, nworkers, chunksPerWorker);
+
+    auto worker = [&]() {
+        Chunk chunk;
+        while (all_chunks.pop(chunk)) {
+            body(chunk.getStart(), chunk.getStop());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nworkers-1; i++) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/*
+Same as above, with the threads of a pool instead of new ones: a solver that does many short sweeps keeps
+the pool alive for all of them, so it doesn't pay for the creation of the threads at every sweep.
+*/
+inline void parallelChunks(int n_indexes, WorkerPool& pool, std::function<void(int, int)> body,
+                           int chunksPerWorker = CHUNKS_PER_WORKER) {
+    if (n_indexes <= 0) return;
+    if (pool.size() <= 1) {
+        body(0, n_indexes);
+        return;
+    }
+    ThreadSafeQueue all_chunks;
+    pushChunks(all_chunks, n_indexes, pool.size(), chunksPerWorker);
+    pool.run([&](int) {
+        Chunk chunk;
+        while (all_chunks.pop(chunk)) {
+            body(chunk.getStart(), chunk.getStop());
+        }
+    });
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef ROW_KERNEL_CPP
+#define ROW_KERNEL_CPP
+
+#include <vector>
+#include <functional>
+#include "grid_view.cpp"
+#include "coefficients.cpp"
+
+/*
+Rows read by a row kernel to compute n consecutive cells of a row, starting at the cell (row, col).
+in[0] points to the cells themselves and in[k] to their neighbors at the k-th offset of the neighborhood,
+so that in[k][j] is neighbor k of the j-th cell of the segment (the same order as in the vector given to a
+stencil function). coefficient(f, k) points to the same cells of the coefficient field f. The kernel writes
+the new values of the cells to out[0], ..., out[n-1].
+*/
+template<typename T>
+struct StencilRows {
+    int row, col;
+    int neighbors; //offsets of the neighborhood, plus the cell itself
+    int fields; //number of coefficient fields
+    const T* const* in;
+    const T* const* coefficients; //`neighbors` pointers per field, one field after the other
+    T* out;
+
+    const T* coefficient(int f, int k) const { return coefficients[f * neighbors + k]; }
+};
+
+/*
+Stencil function applied to a segment of a row at once. The engines call it once per row of a tile instead
+of calling a stencil function per cell with a vector of neighbors: the kernel reads the values straight from
+the rows of the matrix and of the coefficient fields, which have the same layout, so a kernel written as a
+loop over the cells of the segment is vectorized by the compiler.
+*/
+template<typename T>
+using RowKernel = std::function<void(const StencilRows<T>& rows, int n)>;
+
+/*
+Calls the kernel on the cells [col0, col1) of row i, reading data1 and writing data2. pointers is a buffer
+of the calling worker, reused for every row.
+*/
+template<typename T>
+void applyRowKernel(const RowKernel<T>& kernel, const std::vector<std::pair<int, int>>& neighborhood,
+                    const CoefficientFields<T>* coefficients, GridView<T> data1, GridView<T> data2,
+                    int i, int col0, int col1, std::vector<const T*>& pointers) {
+    if (col1 <= col0) return;
+    pointers.clear();
+    pointers.push_back(data1[i] + col0);
+    for (const auto& offset : neighborhood) {
+        pointers.push_back(data1[i + offset.first] + col0 + offset.second);
+    }
+    if (coefficients) coefficients->rowPointers(i, col0, neighborhood, pointers);
+    int neighbors = neighborhood.size() + 1;
+    StencilRows<T> rows{i, col0, neighbors, coefficients ? coefficients->size() : 0,
+                        pointers.data(), pointers.data() + neighbors, data2[i] + col0};
+    kernel(rows, col1 - col0);
+}
+
+/*
+Row kernel of stencilVarDiffusionFunction (in the coefficients driver): diffusion with a conductivity that changes from cell to cell,
+averaged on the face between the cell and each neighbor. The conductivity is the first coefficient field,
+which must be there (the other fields are not read). The values are added in the same order as in the
+function, so the results are the same.
+*/
+template<typename T>
+void varDiffusionRows(const StencilRows<T>& rows, int n) {
+    const T* __restrict center = rows.in[0];
+    const T* __restrict center_conductivity = rows.coefficient(0, 0);
+    T* __restrict out = rows.out;
+    for (int j = 0; j < n; j++) out[j] = center[j];
+    for (int k = 1; k < rows.neighbors; k++) {
+        const T* __restrict neighbor = rows.in[k];
+        const T* __restrict conductivity = rows.coefficient(0, k);
+        for (int j = 0; j < n; j++) {
+            out[j] += 0.2 * ((center_conductivity[j] + conductivity[j]) / 2) * (neighbor[j] - center[j]);
+        }
+    }
+}
+
+#endif
\ No newline at end of file
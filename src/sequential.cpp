@@ -1,10 +1,19 @@
+#ifndef SEQUENTIAL_CPP
+#define SEQUENTIAL_CPP
+
 #include <vector>
 #include <functional>
+#include "arena.cpp"
+#include "tiling.cpp"
+#include "checkpoint.cpp"
+#include "stencil_observer.cpp"
+#include "coefficients.cpp"
+#include "row_kernel.cpp"
 
 template<typename T>
 class StencilPatternSeq {
 public:
-    StencilPatternSeq(std::function<T(std::vector<T>)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations)
+    StencilPatternSeq(std::function<T(const std::vector<T>&)> stencilFunc, std::vector<std::pair<int, int>> neighborhood, int iterations)
     : stencilFunc(stencilFunc), neighborhood(neighborhood), iterations(iterations) {}
 
 
@@ -15,33 +24,49 @@ public:
         The idea is to write the output of the stencil function into the data2 matrix, and after every matrix has
         calculated the output, the data1 and data2 matrices are swapped (std::swap). This method wastes twice the
         memory, but is the fastest way to do the calculations, while remaining thread safe. 
+        The matrices are stored in blocks of the GridArena, which are reused by the next runs.
         */
-        std::vector<std::vector<T>> data1 = data;
-        std::vector<std::vector<T>> data2 = data1;
-        int numRows = data.size();
-        int numCols = data[0].size();
+        ArenaGrid<T> data1(data);
+        //only the border of the second matrix is read, and compute() copies it
+        ArenaGrid<T> data2(data1.rows(), data1.cols());
+        int result = compute(data1.view(), data2.view());
+        return result == 0 ? data1.toVector() : data2.toVector();
+    }
+
+    /*
+    Computes the iterations on matrices owned by the caller, without copying them: a holds the input and b is
+    a scratch matrix of the same size (its border is copied from a). Both are overwritten, and the return
+    value tells which one holds the result (0 for a, 1 for b).
+    */
+    int compute(GridView<T> a, GridView<T> b) {
+        GridView<T> data1 = a;
+        GridView<T> data2 = b;
+        int numRows = a.rows();
+        int numCols = a.cols();
+        if (coefficients) coefficients->check(numRows, numCols);
         /*
-        This section of the code calculates the starting and ending lines and columns, given that the borders of
-        the stencil matrix are not supposed to be calculated. It iterates through the neighborhood input vector
-        and stores the maximum offset of each axis.
+        The borders of the stencil matrix are not supposed to be calculated: only the rows and columns farther
+        from the border than the reach of the neighborhood are.
         */
-        int max_y_offset = 0, max_x_offset = 0, min_y_offset = 0, min_x_offset = 0;
-        for (const auto& offset : neighborhood) {
-            int y_offset = offset.first;
-            int x_offset = offset.second;
-            if (y_offset > max_y_offset) max_y_offset = y_offset;
-            if (y_offset < min_y_offset) min_y_offset = y_offset;
-            if (x_offset > max_x_offset) max_x_offset = x_offset;
-            if (x_offset < min_x_offset) min_x_offset = x_offset;
-        }
+        StencilBounds bounds = stencilBounds(neighborhood, numRows, numCols);
+        copyBorder(a, b, bounds.start_row, bounds.end_row, bounds.start_col, bounds.end_col);
+        //vector of neighbors, reused for every cell so that it is only allocated once
+        std::vector<T> neighbors;
+        neighbors.reserve(neighborhood.size() + 1);
+        //row pointers given to the row kernel, if there is one
+        std::vector<const T*> pointers;
         /*
         This section of the code runs all the iterations in a sequential way
         */
         for (int iter = 0; iter < iterations; ++iter) {
-            for (int i = -min_y_offset; i < numRows-max_y_offset; ++i) {
-                for (int j = -min_x_offset; j < numCols-max_x_offset; ++j) {
-                    //vector of neighbors is created
-                    std::vector<T> neighbors;
+            for (int i = bounds.start_row; i < bounds.end_row; ++i) {
+                if (rowKernel) {
+                    applyRowKernel(rowKernel, neighborhood, coefficients, data1, data2, i, bounds.start_col, bounds.end_col, pointers);
+                    continue;
+                }
+                for (int j = bounds.start_col; j < bounds.end_col; ++j) {
+                    //vector of neighbors is emptied
+                    neighbors.clear();
                     //the current item is taken into account
                     neighbors.push_back(data1[i][j]);
                     //every neighbor is added to the vector of neighbors
@@ -50,17 +75,49 @@ public:
                         int nj = j + offset.second;
                         neighbors.push_back(data1[ni][nj]);
                     }
+                    if (coefficients) coefficients->gather(i, j, neighborhood, neighbors);
                     //the result of the stencil function is stored in the buffer matrix
                     data2[i][j] = stencilFunc(neighbors);
                 }
             }
             //the matrices are swapped so that the next iteration builds up on the computed values
             std::swap(data1,data2);
+            if (checkpoint) checkpoint->onSwap(data1, data2, iter + 1);
+            for (auto observer : observers) observer->onIteration(data1, iter + 1);
         }
-        return data1;
+        if (checkpoint) checkpoint->wait();
+        int result = resultIndex(data1, a, b);
+        if (checkpoint) checkpoint->release();
+        return result;
+    }
+
+    //writes a checkpoint of the matrix periodically while the iterations run
+    void setCheckpoint(CheckpointWriter<T>* writer) {
+        checkpoint = writer;
+    }
+
+    //the observer is called with the matrix computed at the end of every iteration
+    void addObserver(StencilObserver<T>* observer) {
+        observers.push_back(observer);
+    }
+
+    //read-only coefficient fields, appended to the neighbors given to the stencil function
+    void setCoefficients(const CoefficientFields<T>* fields) {
+        coefficients = fields;
+    }
+
+    //stencil function applied to whole rows, used instead of the stencil function if it is set
+    void setRowKernel(RowKernel<T> kernel) {
+        rowKernel = kernel;
     }
 private:
-    std::function<T(std::vector<T>)> stencilFunc; //stencil function to be applied on each neighborhood vector
+    std::function<T(const std::vector<T>&)> stencilFunc; //stencil function to be applied on each neighborhood vector
     std::vector<std::pair<int, int>> neighborhood; //neighborhood offset positions
     int iterations;
-};
\ No newline at end of file
+    CheckpointWriter<T>* checkpoint = nullptr;
+    const CoefficientFields<T>* coefficients = nullptr;
+    RowKernel<T> rowKernel;
+    std::vector<StencilObserver<T>*> observers;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,199 @@
+#ifndef SNAPSHOT_STREAM_CPP
+#define SNAPSHOT_STREAM_CPP
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "stencil_observer.cpp"
+
+/*
+Header of every frame of a snapshot stream, followed by the rows x cols values of the frame.
+*/
+struct SnapshotHeader {
+    char magic[4]; //"SNAP"
+    uint32_t elementSize;
+    int64_t rows;
+    int64_t cols;
+    int64_t iteration;
+};
+
+//what to do with a frame when all the buffers are waiting to be written
+enum class SnapshotPolicy { Block, Drop };
+
+struct SnapshotConfig {
+    int every = 1; //a frame every `every` iterations
+    /*
+    region of the matrix in the frames, a negative size means up to the end of the matrix. The region is
+    clipped to the matrix, so the part of it that falls outside is not in the frames.
+    */
+    int row = 0, col = 0, rows = -1, cols = -1;
+    int stride = 1; //downsampling: one cell every `stride` rows and columns of the region
+    int buffers = 4; //frames that can be waiting for the writer
+    SnapshotPolicy policy = SnapshotPolicy::Block;
+};
+
+/*
+Observer that streams snapshots of the matrix every k iterations.
+Each frame is the (optionally cropped and downsampled) matrix copied into one of a fixed set of buffers,
+which are queued to a writer thread and recycled once written. The compute loop only pays for the copy of
+the frame: if the writer falls behind and all the buffers are in the queue, the frame is dropped or the
+compute waits for a buffer, depending on the policy.
+The frames are appended to a single binary file, or written to one file per frame (path_<iteration>.bin).
+*/
+template<typename T>
+class SnapshotStream : public StencilObserver<T> {
+public:
+    SnapshotStream(std::string path, bool fileSequence, SnapshotConfig config)
+    : path(path), fileSequence(fileSequence), config(config), free_buffers(std::max(1, config.buffers)) {
+        if (!fileSequence) {
+            out = fopen(path.c_str(), "wb");
+            if (!out) writeFailed = true;
+        }
+        writer = std::thread([this]() { writerLoop(); });
+    }
+
+    ~SnapshotStream() {
+        close();
+    }
+
+    void onIteration(const GridView<T>& data, long completed) override {
+        if (config.every <= 0 || completed % config.every != 0) return;
+        int stride = config.stride > 0 ? config.stride : 1;
+        //the region is clipped here since the size of the matrix is only known now (in long, no overflow)
+        int row_begin = std::clamp(config.row, 0, data.rows());
+        int col_begin = std::clamp(config.col, 0, data.cols());
+        int row_end = config.rows < 0 ? data.rows() : std::clamp<long>((long) config.row + config.rows, row_begin, data.rows());
+        int col_end = config.cols < 0 ? data.cols() : std::clamp<long>((long) config.col + config.cols, col_begin, data.cols());
+        int frame_rows = (row_end - row_begin + stride - 1) / stride;
+        int frame_cols = (col_end - col_begin + stride - 1) / stride;
+        if (frame_rows <= 0 || frame_cols <= 0) return;
+
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            if (free_buffers.empty()) {
+                if (config.policy == SnapshotPolicy::Drop) {
+                    dropped++;
+                    return;
+                }
+                auto start = std::chrono::system_clock::now();
+                cv.wait(lock, [this]() { return !free_buffers.empty(); });
+                blockedTime += std::chrono::system_clock::now() - start;
+            }
+            frame.values = std::move(free_buffers.back());
+            free_buffers.pop_back();
+        }
+
+        //the frame is copied outside of the lock, the writer may be writing another one meanwhile
+        frame.rows = frame_rows;
+        frame.cols = frame_cols;
+        frame.iteration = completed;
+        frame.values.resize((size_t) frame_rows * frame_cols);
+        T* dst = frame.values.data();
+        for (int i = row_begin; i < row_end; i += stride) {
+            const T* row = data[i];
+            for (int j = col_begin; j < col_end; j += stride) {
+                *dst++ = row[j];
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m);
+            frames.push(std::move(frame));
+        }
+        cv.notify_all();
+    }
+
+    //writes the frames in the queue and stops the writer
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (stop) return;
+            stop = true;
+        }
+        cv.notify_all();
+        writer.join();
+        if (out) fclose(out);
+        out = nullptr;
+    }
+
+    long framesWritten() const { return written; }
+    long framesDropped() const { return dropped; }
+    bool failed() const { return writeFailed; }
+
+    //time the compute waited for a free buffer, in microseconds
+    long blockedMicroseconds() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(blockedTime).count();
+    }
+
+private:
+    struct Frame {
+        int rows = 0, cols = 0;
+        long iteration = 0;
+        std::vector<T> values;
+    };
+
+    std::string path;
+    bool fileSequence;
+    SnapshotConfig config;
+    FILE* out = nullptr;
+    std::thread writer;
+    std::mutex m;
+    std::condition_variable cv;
+    std::queue<Frame> frames; //frames waiting to be written
+    std::vector<std::vector<T>> free_buffers; //buffers that can be filled with a frame
+    bool stop = false;
+    bool writeFailed = false;
+    long written = 0;
+    long dropped = 0;
+    std::chrono::duration<double> blockedTime = std::chrono::duration<double>::zero();
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(m);
+        while (true) {
+            cv.wait(lock, [this]() { return !frames.empty() || stop; });
+            if (frames.empty()) return;
+            Frame frame = std::move(frames.front());
+            frames.pop();
+            lock.unlock();
+
+            bool ok = write(frame);
+
+            lock.lock();
+            if (ok) written++;
+            else writeFailed = true;
+            //the buffer goes back to the compute
+            free_buffers.push_back(std::move(frame.values));
+            cv.notify_all();
+        }
+    }
+
+    bool write(const Frame& frame) {
+        FILE* f = out;
+        if (fileSequence) {
+            std::string name = path + "_" + std::to_string(frame.iteration) + ".bin";
+            f = fopen(name.c_str(), "wb");
+        }
+        if (!f) return false;
+        SnapshotHeader header;
+        memcpy(header.magic, "SNAP", 4);
+        header.elementSize = sizeof(T);
+        header.rows = frame.rows;
+        header.cols = frame.cols;
+        header.iteration = frame.iteration;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+            && fwrite(frame.values.data(), sizeof(T), frame.values.size(), f) == frame.values.size();
+        if (fileSequence) ok = (fclose(f) == 0) && ok;
+        return ok;
+    }
+};
+
+#endif
\ No newline at end of file
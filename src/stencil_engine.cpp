@@ -0,0 +1,161 @@
+#ifndef STENCIL_ENGINE_CPP
+#define STENCIL_ENGINE_CPP
+
+#include <vector>
+#include <functional>
+#include <string>
+#include <map>
+#include <memory>
+#include <set>
+#include "sequential.cpp"
+#include "new_par_threads.cpp"
+#include "par_fastflow.cpp"
+#include "par_openmp.cpp"
+#include "par_ff_wavefront.cpp"
+#include "util.h"
+
+/*
+Everything a stencil engine is built with. The sequential engine ignores the workers and the chunks, and
+the tile shape is only used by the engines that split the matrix in tiles.
+*/
+template<typename T>
+struct StencilEngineParams {
+    std::function<T(const std::vector<T>&)> stencilFunc; //stencil function to be applied on each neighborhood vector
+    std::string kernelName; //name of the stencil function (stencilFunctionByName), for the engines that look it up
+    std::vector<std::pair<int, int>> neighborhood; //neighborhood offset positions
+    int iterations = 1;
+    int nworkers = 1;
+    int chunksPerWorker = CHUNKS_PER_WORKER;
+    TileShape tileShape; //chosen from the cache sizes by default
+    const CoefficientFields<T>* coefficients = nullptr; //read-only coefficient fields, if the stencil has them
+    RowKernel<T> rowKernel; //applied to whole rows instead of stencilFunc, if it is set
+    WorkerPool* pool = nullptr; //threads that par_threads runs on instead of nworkers new ones, if given
+};
+
+/*
+Common interface of the stencil implementations, so that the drivers can pick one at runtime and run
+several of them on the same input.
+compute() works on matrices owned by the caller: a holds the input, b is a scratch matrix of the same
+size, and the return value tells which one holds the result (0 for a, 1 for b).
+*/
+template<typename T>
+class StencilEngine {
+public:
+    virtual ~StencilEngine() {}
+    virtual std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) = 0;
+    virtual int compute(GridView<T> a, GridView<T> b) = 0;
+};
+
+/*
+Engine that forwards to one of the StencilPattern classes, built with the engine parameters. The patterns
+without a compute() of their own go through vectors, copying the result into a.
+*/
+template<typename T, typename Pattern>
+class StencilPatternEngine : public StencilEngine<T> {
+public:
+    StencilPatternEngine(Pattern pattern) : pattern(pattern) {}
+
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) override {
+        return pattern(data);
+    }
+
+    int compute(GridView<T> a, GridView<T> b) override {
+        if constexpr (requires { pattern.compute(a, b); }) {
+            return pattern.compute(a, b);
+        } else {
+            std::vector<std::vector<T>> result = pattern(a.toVector());
+            for (int i = 0; i < a.rows(); i++) std::copy(result[i].begin(), result[i].end(), a[i]);
+            return 0;
+        }
+    }
+private:
+    Pattern pattern;
+};
+
+/*
+Registry of the stencil engines by name. It starts with the sequential, native threads, FastFlow (parallel
+for and wavefront) and OpenMP implementations, and other engines can be added with add().
+*/
+template<typename T>
+class StencilEngineRegistry {
+public:
+    using Factory = std::function<std::unique_ptr<StencilEngine<T>>(const StencilEngineParams<T>&)>;
+
+    static StencilEngineRegistry& instance() {
+        static StencilEngineRegistry registry;
+        return registry;
+    }
+
+    //tiled tells if the engine uses the tile shape of the parameters
+    void add(const std::string& name, Factory factory, bool tiled = false) {
+        factories[name] = factory;
+        if (tiled) tiledEngines.insert(name);
+        else tiledEngines.erase(name);
+    }
+
+    bool has(const std::string& name) const {
+        return factories.count(name) > 0;
+    }
+
+    //returns the engine with the given name, or nullptr if there isn't one
+    std::unique_ptr<StencilEngine<T>> create(const std::string& name, const StencilEngineParams<T>& params) const {
+        auto it = factories.find(name);
+        if (it == factories.end()) return nullptr;
+        return it->second(params);
+    }
+
+    bool tiled(const std::string& name) const {
+        return tiledEngines.count(name) > 0;
+    }
+
+    std::vector<std::string> names() const {
+        std::vector<std::string> result;
+        for (auto& entry : factories) result.push_back(entry.first);
+        return result;
+    }
+
+private:
+    std::map<std::string, Factory> factories;
+    std::set<std::string> tiledEngines;
+
+    template<typename Pattern>
+    static std::unique_ptr<StencilEngine<T>> wrap(Pattern pattern) {
+        return std::make_unique<StencilPatternEngine<T, Pattern>>(pattern);
+    }
+
+    StencilEngineRegistry() {
+        add("seq", [](const StencilEngineParams<T>& p) {
+            StencilPatternSeq<T> sp(p.stencilFunc, p.neighborhood, p.iterations);
+            sp.setCoefficients(p.coefficients);
+            sp.setRowKernel(p.rowKernel);
+            return wrap(sp);
+        });
+        add("par_threads", [](const StencilEngineParams<T>& p) {
+            NewStencilPatternParThreads<T> sp(p.stencilFunc, p.neighborhood, p.iterations, p.nworkers, p.chunksPerWorker, p.tileShape);
+            sp.setCoefficients(p.coefficients);
+            sp.setRowKernel(p.rowKernel);
+            sp.setWorkerPool(p.pool);
+            return wrap(sp);
+        }, true);
+        add("par_ff", [](const StencilEngineParams<T>& p) {
+            StencilPatternParFF<T> sp(p.stencilFunc, p.neighborhood, p.iterations, p.nworkers, p.chunksPerWorker, p.tileShape);
+            sp.setCoefficients(p.coefficients);
+            sp.setRowKernel(p.rowKernel);
+            return wrap(sp);
+        }, true);
+        add("par_ff_wavefront", [](const StencilEngineParams<T>& p) {
+            StencilPatternParFFWavefront<T> sp(p.stencilFunc, p.neighborhood, p.iterations, p.nworkers, p.chunksPerWorker);
+            sp.setCoefficients(p.coefficients);
+            sp.setRowKernel(p.rowKernel);
+            return wrap(sp);
+        });
+        add("par_omp", [](const StencilEngineParams<T>& p) {
+            StencilPatternParOMP<T> sp(p.stencilFunc, p.neighborhood, p.iterations, p.nworkers, p.chunksPerWorker, p.tileShape);
+            sp.setCoefficients(p.coefficients);
+            sp.setRowKernel(p.rowKernel);
+            return wrap(sp);
+        }, true);
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef STENCIL_OBSERVER_CPP
+#define STENCIL_OBSERVER_CPP
+
+#include <vector>
+#include "grid_view.cpp"
+
+/*
+Observer of a stencil computation. The engines that support observers call onIteration() at the end of
+every iteration, after swapping the matrices, with the matrix computed in that iteration. The engine
+doesn't go on until onIteration() returns, so it has to be quick (the heavy work belongs in another thread).
+*/
+template<typename T>
+class StencilObserver {
+public:
+    virtual ~StencilObserver() {}
+    virtual void onIteration(const GridView<T>& data, long completed) = 0;
+};
+
+#endif
\ No newline at end of file
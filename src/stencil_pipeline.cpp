@@ -0,0 +1,257 @@
+#ifndef STENCIL_PIPELINE_CPP
+#define STENCIL_PIPELINE_CPP
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include "iteration_runner.cpp"
+#include "tiling.cpp"
+#include "util.h"
+#include "arena.cpp"
+
+/*
+One stage of a stencil pipeline: a stencil function and the neighborhood it is applied on.
+It holds exactly what a single StencilPattern object is constructed with (apart from the iterations).
+*/
+template<typename T>
+struct StencilStage {
+    std::function<T(const std::vector<T>&)> stencilFunc; //stencil function to be applied on each neighborhood vector
+    std::vector<std::pair<int, int>> neighborhood; //neighborhood offset positions
+};
+
+/*
+Fused computation of a tile of a stencil pipeline.
+Running the stages one after the other means a full sweep over the matrix (and a swap) per stage. Here
+every tile of output cells is computed through all the stages at once: each stage is computed on the tile
+extended by the halo that the following stages need, in a small scratch buffer that stays in cache
+(tileShape() sizes the tiles for it). The halo is recomputed by the neighboring tiles, which is cheap as
+long as the tiles are much larger than the sum of the offsets of the stages.
+The result is exactly the same as applying the stages separately, one iteration each: cells that are on
+the border of a stage (the ones the stage doesn't calculate) keep the value of the previous stage.
+*/
+template<typename T>
+class StencilPipelineTile {
+public:
+    StencilPipelineTile(std::vector<StencilStage<T>> stages, int numRows, int numCols)
+    : stages(stages), numRows(numRows), numCols(numCols) {
+        /*
+        For every stage, we store the interior it calculates (same calculation as in the StencilPattern classes)
+        and how many rows above and below a cell it reads.
+        */
+        for (auto& stage : stages) {
+            StencilBounds bounds = stencilBounds(stage.neighborhood, numRows, numCols);
+            start_row.push_back(bounds.start_row);
+            end_row.push_back(bounds.end_row);
+            start_col.push_back(bounds.start_col);
+            end_col.push_back(bounds.end_col);
+        }
+    }
+
+    /*
+    Sum of the vertical offsets of all the stages, which is the number of rows each tile recomputes
+    on top of its own rows.
+    */
+    int halo() const {
+        int h = 0;
+        for (size_t s = 0; s < stages.size(); s++) {
+            h += start_row[s] + (numRows - end_row[s]);
+        }
+        return h;
+    }
+
+    //same for the horizontal offsets and the columns
+    int haloCols() const {
+        int h = 0;
+        for (size_t s = 0; s < stages.size(); s++) {
+            h += start_col[s] + (numCols - end_col[s]);
+        }
+        return h;
+    }
+
+    /*
+    Shape of the tiles, so that the scratch buffers of the intermediate stages of a tile (extended by the
+    halo), plus the rows it reads and writes, fit in half of L2. The tiles are bands of whole rows when a
+    band at least twice as tall as the halo fits, otherwise the columns are split too, in about square
+    tiles. The height is then reduced if needed so that there are at least minTiles tiles, but the tiles
+    stay twice as tall as the halo they recompute.
+    */
+    TileShape tileShape(int minTiles, TileShape requested = TileShape()) const {
+        long budget = cacheSize(2) / 2 / (long) sizeof(T) / (stages.size() + 1); //elements per buffer
+        long halo_rows = halo(), halo_cols = haloCols();
+        long min_rows = std::max<long>(8, 2 * halo_rows);
+        TileShape shape = requested;
+        if (shape.cols <= 0) {
+            if ((min_rows + halo_rows) * (numCols + halo_cols) <= budget) shape.cols = numCols;
+            else shape.cols = (int) std::max<long>(std::max<long>(8, 2 * halo_cols), (long) std::sqrt((double) budget) - halo_cols);
+        }
+        shape.cols = std::max(1, std::min(shape.cols, numCols));
+        if (shape.rows <= 0) {
+            long height = budget / (shape.cols + halo_cols) - halo_rows;
+            long strips = (numCols + shape.cols - 1) / shape.cols;
+            long bands_needed = (minTiles + strips - 1) / strips;
+            if (bands_needed > 1) height = std::min<long>(height, numRows / bands_needed);
+            shape.rows = (int) std::min<long>(std::max(min_rows, height), numRows);
+        }
+        shape.rows = std::max(1, std::min(shape.rows, numRows));
+        return shape;
+    }
+
+    //tiles that cover the whole matrix, the cells on the border of the stages included
+    std::vector<Tile> tiles(TileShape shape) const {
+        return makeTiles(0, numRows, 0, numCols, shape);
+    }
+
+    /*
+    Computes the output cells of the tile through the whole pipeline, reading from data1 and writing to
+    data2. The cells of the intermediate stages are allocated from the scratch arena of the calling thread,
+    which is reset on every call, so they don't go through malloc.
+    */
+    void operator()(const ArenaGrid<T>& data1, ArenaGrid<T>& data2, const Tile& tile) const {
+        int numStages = stages.size();
+        /*
+        The rows and columns needed from each stage are calculated backwards: the last stage computes the
+        tile itself, and each stage needs the cells of the following one extended by the offsets of the
+        following one.
+        */
+        std::vector<int> lo(numStages), hi(numStages), left(numStages), right(numStages);
+        lo[numStages-1] = tile.row0;
+        hi[numStages-1] = tile.row1;
+        left[numStages-1] = tile.col0;
+        right[numStages-1] = tile.col1;
+        for (int s = numStages-1; s > 0; s--) {
+            lo[s-1] = std::max(0, lo[s] - start_row[s]);
+            hi[s-1] = std::min(numRows, hi[s] + (numRows - end_row[s]));
+            left[s-1] = std::max(0, left[s] - start_col[s]);
+            right[s-1] = std::min(numCols, right[s] + (numCols - end_col[s]));
+        }
+        ScratchArena& arena = ScratchArena::local();
+        arena.reset();
+        std::vector<T*> scratch(numStages);
+        //vector of neighbors, reused for every cell of the tile
+        std::vector<T> neighbors;
+
+        for (int s = 0; s < numStages; s++) {
+            /*
+            The first stage reads the input matrix, every other stage reads the scratch cells of the previous
+            one. in(line) and out(line) point to the first column of their row that is stored, which is in_col
+            and out_col.
+            */
+            int in_col = s == 0 ? 0 : left[s-1];
+            int out_col = s == numStages-1 ? 0 : left[s];
+            auto in = [&](int line) -> const T* {
+                if (s == 0) return data1[line];
+                return scratch[s-1] + (size_t) (line - lo[s-1]) * (right[s-1] - left[s-1]);
+            };
+            if (s < numStages-1) scratch[s] = arena.allocate<T>((size_t) (hi[s] - lo[s]) * (right[s] - left[s]));
+            auto out = [&](int line) -> T* {
+                if (s == numStages-1) return data2[line];
+                return scratch[s] + (size_t) (line - lo[s]) * (right[s] - left[s]);
+            };
+
+            const StencilStage<T>& stage = stages[s];
+            for (int line = lo[s]; line < hi[s]; line++) {
+                const T* src = in(line);
+                T* dst = out(line);
+                if (line < start_row[s] || line >= end_row[s]) {
+                    //rows on the border of this stage keep the value of the previous stage
+                    std::copy(src + (left[s] - in_col), src + (right[s] - in_col), dst + (left[s] - out_col));
+                    continue;
+                }
+                for (int column = left[s]; column < right[s]; column++) {
+                    if (column < start_col[s] || column >= end_col[s]) {
+                        dst[column - out_col] = src[column - in_col];
+                        continue;
+                    }
+                    //empty the neighbor vector
+                    neighbors.clear();
+                    //push the current index
+                    neighbors.push_back(src[column - in_col]);
+                    //push all the neighbors
+                    for (auto offset : stage.neighborhood) {
+                        neighbors.push_back(in(line + offset.first)[column + offset.second - in_col]);
+                    }
+                    //The result of the stencil function is placed in the output row
+                    dst[column - out_col] = stage.stencilFunc(neighbors);
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<StencilStage<T>> stages;
+    int numRows;
+    int numCols;
+    std::vector<int> start_row, end_row, start_col, end_col; //interior calculated by each stage
+};
+
+/*
+Sequential fused pipeline. Every iteration applies all the stages, tile by tile.
+*/
+template<typename T>
+class StencilPipelineSeq {
+public:
+    StencilPipelineSeq(std::vector<StencilStage<T>> stages, int iterations, TileShape tileShape = TileShape())
+    : stages(stages), iterations(iterations), tileShape(tileShape) {}
+
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) {
+        ArenaGrid<T> data1(data);
+        ArenaGrid<T> data2 = data1;
+        int numRows = data.size();
+        int numCols = data[0].size();
+        StencilPipelineTile<T> fused(stages, numRows, numCols);
+        std::vector<Tile> tiles = fused.tiles(fused.tileShape(1, tileShape));
+
+        for (int iter = 0; iter < iterations; ++iter) {
+            for (const Tile& tile : tiles) {
+                fused(data1, data2, tile);
+            }
+            //the matrices are swapped so that the next iteration builds up on the computed values
+            std::swap(data1, data2);
+        }
+        return data1.toVector();
+    }
+private:
+    std::vector<StencilStage<T>> stages;
+    int iterations;
+    TileShape tileShape; //0 is chosen from the cache sizes and the halo of the stages
+};
+
+/*
+Fused pipeline with C++ native threads. The tiles are computed by an IterationRunner, like the tiles of
+NewStencilPatternParThreads, and the completion of its barrier swaps the matrices.
+*/
+template<typename T>
+class StencilPipelineParThreads {
+public:
+    StencilPipelineParThreads(std::vector<StencilStage<T>> stages, int iterations, int nworkers, TileShape tileShape = TileShape())
+    : stages(stages), iterations(iterations), nworkers(nworkers), tileShape(tileShape) {}
+
+    std::vector<std::vector<T>> operator()(const std::vector<std::vector<T>>& data) {
+        ArenaGrid<T> data1(data, nworkers);
+        ArenaGrid<T> data2(data, nworkers);
+        int numRows = data.size();
+        int numCols = data[0].size();
+        StencilPipelineTile<T> fused(stages, numRows, numCols);
+        //at least CHUNKS_PER_WORKER tiles per worker, as long as they fit in the cache
+        std::vector<Tile> tiles = fused.tiles(fused.tileShape(nworkers*CHUNKS_PER_WORKER, tileShape));
+
+        //the tiles are the units of the IterationRunner, whose barrier swaps the matrices after every iteration
+        IterationRunner runner(nworkers);
+        runner.run(tiles.size(), iterations,
+            [&](int, int first, int last) {
+                for (int t = first; t < last; t++) {
+                    fused(data1, data2, tiles[t]);
+                }
+            },
+            [&](int) { std::swap(data1, data2); });
+        return data1.toVector();
+    }
+private:
+    std::vector<StencilStage<T>> stages;
+    int iterations;
+    int nworkers;
+    TileShape tileShape; //0 is chosen from the cache sizes, the halo of the stages and the number of workers
+};
+
+#endif
\ No newline at end of file
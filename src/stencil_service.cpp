@@ -0,0 +1,456 @@
+#ifndef STENCIL_SERVICE_CPP
+#define STENCIL_SERVICE_CPP
+
+#include <vector>
+#include <functional>
+#include <string>
+#include <sstream>
+#include <deque>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "checkpoint.cpp"
+#include "arena.cpp"
+#include "worker_pool.cpp"
+#include "stencil_engine.cpp"
+#include "util.h"
+
+/*
+The matrices of the jobs are passed to the service in the checkpoint file format (a CheckpointHeader
+followed by the rows), either in a file, given by its path, or in a POSIX shared memory object, given as
+"shm:/name". Both are mapped in memory, so the rows go straight from the mapping into the matrix.
+*/
+inline int openGridLocation(const std::string& location, int flags) {
+    if (location.rfind("shm:", 0) == 0) return shm_open(location.substr(4).c_str(), flags, 0644);
+    return open(location.c_str(), flags, 0644);
+}
+
+inline void removeGridLocation(const std::string& location) {
+    if (location.rfind("shm:", 0) == 0) shm_unlink(location.substr(4).c_str());
+    else unlink(location.c_str());
+}
+
+template<typename T>
+bool readGrid(const std::string& location, ArenaGrid<T>& grid, std::string& error) {
+    int fd = openGridLocation(location, O_RDONLY);
+    if (fd < 0) {
+        error = "can't open " + location;
+        return false;
+    }
+    struct stat st;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(CheckpointHeader)) {
+        mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        error = "can't map " + location;
+        return false;
+    }
+    CheckpointHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    /*
+    The sizes come from the file, so they are checked before they are used: they must fit in an int, and the
+    size of the values is computed without overflowing before it is compared with the size of the file.
+    */
+    bool ok = memcmp(header.magic, "STCK", 4) == 0 && header.elementSize == sizeof(T)
+        && header.rows > 0 && header.cols > 0 && header.rows <= INT_MAX && header.cols <= INT_MAX;
+    if (ok) {
+        uint64_t available = (uint64_t) st.st_size - sizeof(header);
+        uint64_t rowBytes = (uint64_t) header.cols * sizeof(T);
+        ok = (uint64_t) header.rows <= available / rowBytes;
+    }
+    if (ok) {
+        grid = ArenaGrid<T>(header.rows, header.cols);
+        const T* values = (const T*) ((const char*) mapping + sizeof(header));
+        for (int i = 0; i < grid.rows(); i++) {
+            memcpy(grid[i], values + (size_t) i * grid.cols(), grid.cols() * sizeof(T));
+        }
+    } else {
+        error = location + " is not a matrix of the right type";
+    }
+    munmap(mapping, st.st_size);
+    return ok;
+}
+
+template<typename T>
+bool writeGrid(const std::string& location, const ArenaGrid<T>& grid, long iteration, std::string& error) {
+    int fd = openGridLocation(location, O_RDWR | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        error = "can't open " + location;
+        return false;
+    }
+    size_t size = sizeof(CheckpointHeader) + (size_t) grid.rows() * grid.cols() * sizeof(T);
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        error = "can't map " + location;
+        return false;
+    }
+    CheckpointHeader header;
+    memcpy(header.magic, "STCK", 4);
+    header.elementSize = sizeof(T);
+    header.rows = grid.rows();
+    header.cols = grid.cols();
+    header.iteration = iteration;
+    memcpy(mapping, &header, sizeof(header));
+    T* values = (T*) ((char*) mapping + sizeof(header));
+    for (int i = 0; i < grid.rows(); i++) {
+        memcpy(values + (size_t) i * grid.cols(), grid[i], grid.cols() * sizeof(T));
+    }
+    munmap(mapping, size);
+    return true;
+}
+
+/*
+Reads the lines of a request/response protocol from a socket.
+*/
+class LineSocket {
+public:
+    explicit LineSocket(int fd) : fd(fd) {}
+
+    bool readLine(std::string& line) {
+        while (true) {
+            size_t end = buffer.find('\n');
+            if (end != std::string::npos) {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                return true;
+            }
+            char chunk[4096];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            buffer.append(chunk, n);
+        }
+    }
+
+    bool writeLine(const std::string& line) {
+        std::string message = line + "\n";
+        size_t sent = 0;
+        while (sent < message.size()) {
+            ssize_t n = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+private:
+    int fd;
+    std::string buffer;
+};
+
+inline int connectService(const std::string& socketPath) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+A job of the service: apply the stencil function `kernel` for `iterations` iterations to the matrix in
+`input` and write the result to `output`.
+*/
+struct StencilJob {
+    std::string kernel;
+    int iterations = 1;
+    std::string input;
+    std::string output;
+
+    bool ok = false;
+    std::string error;
+    long queueMicroseconds = 0; //from the arrival of the request to the start of the job
+    long serviceMicroseconds = 0; //from the start of the job to the result written
+    std::chrono::system_clock::time_point arrival;
+    std::chrono::system_clock::time_point start;
+    std::promise<void> finished;
+};
+
+/*
+Daemon that runs stencil jobs sent through a Unix domain socket.
+The protocol is one line per request, each answered by one line:
+    RUN kernel iterations input output  ->  OK queue_usec service_usec | ERR message
+    STATS                               ->  OK jobs batches
+    SHUTDOWN                            ->  OK (the daemon stops)
+The matrices use the von Neumann neighborhood of the drivers and the borders are not calculated.
+The workers are started once, and the matrices of the jobs come from the GridArena, so after the first
+jobs of a given size they are served by blocks that are already mapped and faulted in (prewarm() does it
+before the first request). A dispatcher thread takes the jobs in arrival order: a large job runs on the
+registered par_threads engine, on the threads of the pool, while the small jobs waiting in the queue (fewer
+cell updates than smallJobCells) are grouped in a batch and run one per worker with the seq engine, since
+splitting them would cost more in synchronization than it saves. setParallelEngine() picks another
+registered engine for the large jobs, like "auto" to run the configurations of a tuning cache.
+*/
+class StencilService {
+public:
+    StencilService(std::string socketPath, int nworkers, long smallJobCells = 1 << 18)
+    : socketPath(socketPath), nworkers(nworkers), smallJobCells(smallJobCells), pool(nworkers) {
+        neighborhood = {
+            std::pair<int,int>(-1,0),
+            std::pair<int,int>(1,0),
+            std::pair<int,int>(0,1),
+            std::pair<int,int>(0,-1)
+        };
+    }
+
+    //engine of the large jobs, which is given the pool of the service
+    void setParallelEngine(const std::string& engine) {
+        parallelEngine = engine;
+    }
+
+    ~StencilService() {
+        if (listener >= 0) close(listener);
+    }
+
+    //maps and faults in the matrices of `count` jobs of the given size, so that the first jobs don't pay for it
+    void prewarm(int rows, int cols, int count) {
+        std::vector<ArenaGrid<double>> grids;
+        for (int g = 0; g < 3 * count; g++) {
+            grids.emplace_back(rows, cols);
+            memset(grids.back().data(), 0, (size_t) rows * grids.back().rowStride() * sizeof(double));
+        }
+    }
+
+    bool listen(std::string& error) {
+        unlink(socketPath.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        if (listener < 0 || bind(listener, (sockaddr*) &addr, sizeof(addr)) < 0 || ::listen(listener, 128) < 0) {
+            error = "can't listen on " + socketPath + ": " + strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    //accepts connections until a SHUTDOWN request
+    void serve() {
+        std::thread dispatcher([this]() { dispatcherLoop(); });
+        std::vector<std::thread> connections;
+        while (true) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) break;
+            std::lock_guard<std::mutex> lock(m);
+            if (stop) {
+                close(fd);
+                break;
+            }
+            clients.push_back(fd);
+            connections.push_back(std::thread([this, fd]() { connectionLoop(fd); }));
+        }
+        {
+            //the connections still open are closed, their threads stop at the next read
+            std::lock_guard<std::mutex> lock(m);
+            stop = true;
+            for (int fd : clients) ::shutdown(fd, SHUT_RDWR);
+        }
+        cv.notify_all();
+        for (auto& connection : connections) connection.join();
+        dispatcher.join();
+        unlink(socketPath.c_str());
+    }
+
+    long jobsServed() const { return jobs; }
+    long batchesServed() const { return batches; }
+
+private:
+    std::string socketPath;
+    int nworkers;
+    long smallJobCells;
+    WorkerPool pool;
+    std::string parallelEngine = "par_threads";
+    std::vector<std::pair<int, int>> neighborhood;
+    int listener = -1;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<StencilJob>> queue; //jobs waiting for the dispatcher
+    std::vector<int> clients;
+    bool stop = false;
+    std::atomic<long> jobs{0};
+    std::atomic<long> batches{0};
+
+    void connectionLoop(int fd) {
+        LineSocket connection(fd);
+        std::string line;
+        while (connection.readLine(line)) {
+            std::istringstream request(line);
+            std::string command;
+            request >> command;
+            if (command == "RUN") {
+                auto job = std::make_shared<StencilJob>();
+                job->arrival = std::chrono::system_clock::now();
+                if (!(request >> job->kernel >> job->iterations >> job->input >> job->output) || job->iterations < 0) {
+                    connection.writeLine("ERR usage: RUN kernel iterations input output");
+                    continue;
+                }
+                auto finished = job->finished.get_future();
+                bool accepted;
+                {
+                    //once stop is set the dispatcher may have returned, and nobody would run the job
+                    std::lock_guard<std::mutex> lock(m);
+                    accepted = !stop;
+                    if (accepted) queue.push_back(job);
+                }
+                if (!accepted) {
+                    connection.writeLine("ERR shutting down");
+                    break;
+                }
+                cv.notify_all();
+                finished.wait();
+                if (job->ok) {
+                    connection.writeLine("OK " + std::to_string(job->queueMicroseconds) + " " + std::to_string(job->serviceMicroseconds));
+                } else {
+                    connection.writeLine("ERR " + job->error);
+                }
+            } else if (command == "STATS") {
+                connection.writeLine("OK " + std::to_string(jobs) + " " + std::to_string(batches));
+            } else if (command == "SHUTDOWN") {
+                connection.writeLine("OK");
+                {
+                    std::lock_guard<std::mutex> lock(m);
+                    stop = true;
+                }
+                cv.notify_all();
+                //wakes up the accept of serve()
+                ::shutdown(listener, SHUT_RDWR);
+                break;
+            } else {
+                connection.writeLine("ERR unknown command " + command);
+            }
+        }
+        std::lock_guard<std::mutex> lock(m);
+        close(fd);
+        clients.erase(std::find(clients.begin(), clients.end(), fd));
+    }
+
+    static long cells(const StencilJob& job, int rows, int cols) {
+        return (long) rows * cols * std::max(1, job.iterations);
+    }
+
+    void dispatcherLoop() {
+        while (true) {
+            std::vector<std::shared_ptr<StencilJob>> batch;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [this]() { return stop || !queue.empty(); });
+                if (queue.empty()) return;
+                batch.push_back(queue.front());
+                queue.pop_front();
+            }
+            ArenaGrid<double> first;
+            begin(*batch[0]);
+            if (!load(*batch[0], first)) {
+                finish(*batch[0]);
+                continue;
+            }
+            if (nworkers <= 1 || cells(*batch[0], first.rows(), first.cols()) >= smallJobCells) {
+                runParallel(*batch[0], first);
+                finish(*batch[0]);
+                continue;
+            }
+            {
+                //the small jobs that are already waiting join the batch, one per worker
+                std::lock_guard<std::mutex> lock(m);
+                while ((int) batch.size() < nworkers && !queue.empty()) {
+                    batch.push_back(queue.front());
+                    queue.pop_front();
+                }
+            }
+            batches++;
+            pool.run([&](int id) {
+                for (int b = id; b < (int) batch.size(); b += nworkers) {
+                    StencilJob& job = *batch[b];
+                    ArenaGrid<double> data;
+                    if (b == 0) data = std::move(first);
+                    else {
+                        begin(job);
+                        if (!load(job, data)) {
+                            finish(job);
+                            continue;
+                        }
+                    }
+                    //a large job that arrived while the batch was formed still runs on this worker only
+                    runSequential(job, data);
+                    finish(job);
+                }
+            });
+        }
+    }
+
+    void begin(StencilJob& job) {
+        job.start = std::chrono::system_clock::now();
+        job.queueMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(job.start - job.arrival).count();
+    }
+
+    bool load(StencilJob& job, ArenaGrid<double>& data) {
+        if (!stencilFunctionByName(job.kernel)) {
+            job.error = "unknown kernel " + job.kernel;
+            return false;
+        }
+        return readGrid(job.input, data, job.error);
+    }
+
+    void finish(StencilJob& job) {
+        job.serviceMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - job.start).count();
+        jobs++;
+        job.finished.set_value();
+    }
+
+    /*
+    Runs the job with the registered engine of the given name, on the matrix read for it and on a scratch
+    matrix from the GridArena, which after the first jobs of a size is a block that is already mapped. The
+    engine computes on the two matrices without copying them, and the one with the result is written.
+    */
+    void run(StencilJob& job, ArenaGrid<double>& data, const std::string& engine, WorkerPool* workers) {
+        StencilEngineParams<double> params;
+        params.stencilFunc = stencilFunctionByName(job.kernel);
+        params.kernelName = job.kernel;
+        params.neighborhood = neighborhood;
+        params.iterations = job.iterations;
+        params.nworkers = workers ? workers->size() : 1;
+        params.pool = workers;
+        ArenaGrid<double> scratch(data.rows(), data.cols());
+        auto sp = StencilEngineRegistry<double>::instance().create(engine, params);
+        int result = sp->compute(data.view(), scratch.view());
+        job.ok = writeGrid(job.output, result == 0 ? data : scratch, job.iterations, job.error);
+    }
+
+    //a small job, or a large one that arrived while a batch was formed, runs on a single worker
+    void runSequential(StencilJob& job, ArenaGrid<double>& data) {
+        run(job, data, "seq", nullptr);
+    }
+
+    //a large job is computed by all the workers of the pool
+    void runParallel(StencilJob& job, ArenaGrid<double>& data) {
+        run(job, data, nworkers > 1 ? parallelEngine : "seq", nworkers > 1 ? &pool : nullptr);
+    }
+};
+
+#endif
\ No newline at end of file
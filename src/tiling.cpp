@@ -0,0 +1,140 @@
+#ifndef TILING_CPP
+#define TILING_CPP
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <unistd.h>
+
+/*
+Rectangle of cells [row0, row1) x [col0, col1) computed as a unit by a worker.
+*/
+struct Tile {
+    int row0, row1;
+    int col0, col1;
+};
+
+/*
+Size of the tiles. A size of 0 is chosen from the cache sizes by tileShapeFor(), and a number of columns
+larger than the matrix gives tiles as wide as the matrix, i.e. bands of whole rows.
+*/
+struct TileShape {
+    int rows = 0;
+    int cols = 0;
+};
+
+/*
+How far a neighborhood reaches from the cell: the smallest and the largest offset on each axis (0 if it
+doesn't go in that direction).
+*/
+struct NeighborhoodReach {
+    int min_y = 0, max_y = 0;
+    int min_x = 0, max_x = 0;
+};
+
+inline NeighborhoodReach neighborhoodReach(const std::vector<std::pair<int, int>>& neighborhood) {
+    NeighborhoodReach reach;
+    for (auto offset : neighborhood) {
+        reach.min_y = std::min(reach.min_y, offset.first);
+        reach.max_y = std::max(reach.max_y, offset.first);
+        reach.min_x = std::min(reach.min_x, offset.second);
+        reach.max_x = std::max(reach.max_x, offset.second);
+    }
+    return reach;
+}
+
+/*
+Rows [start_row, end_row) and columns [start_col, end_col) of a numRows x numCols matrix that the engines
+calculate: the cells closer to the border than the reach of the neighborhood are not calculated and keep
+their value. When the matrix is too small for the neighborhood the region is empty (end == start).
+*/
+struct StencilBounds {
+    int start_row, end_row;
+    int start_col, end_col;
+
+    int rows() const { return end_row - start_row; }
+    int cols() const { return end_col - start_col; }
+    bool empty() const { return rows() <= 0 || cols() <= 0; }
+};
+
+inline StencilBounds stencilBounds(const std::vector<std::pair<int, int>>& neighborhood, int numRows, int numCols) {
+    NeighborhoodReach reach = neighborhoodReach(neighborhood);
+    int start_row = -reach.min_y, start_col = -reach.min_x;
+    return StencilBounds{start_row, std::max(start_row, numRows - reach.max_y),
+                         start_col, std::max(start_col, numCols - reach.max_x)};
+}
+
+//size in bytes of the data cache of the given level (1 or 2), with a default if the system doesn't tell it
+inline long cacheSize(int level) {
+    long size = -1;
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    size = sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (size <= 0) size = level == 1 ? 32 * 1024 : 1024 * 1024;
+    return size;
+}
+
+/*
+Chooses the shape of the tiles of a rows x cols region for the given neighborhood.
+The width is chosen so that the rows read for one row of the tile (as many as the vertical extent of the
+neighborhood, each one with the horizontal halo) stay in L1 while the row is computed, so that every row
+read from memory is reused by the next rows of the tile. It is a multiple of a cache line.
+The height is chosen so that the whole tile, with its halo and the rows written, fits in half of L2, and is
+reduced if needed so that there are at least minTiles tiles to balance among the workers.
+*/
+template<typename T>
+TileShape tileShapeFor(int rows, int cols, const std::vector<std::pair<int, int>>& neighborhood, int minTiles = 1, TileShape requested = TileShape()) {
+    if (rows <= 0 || cols <= 0) return TileShape{1, 1};
+    NeighborhoodReach reach = neighborhoodReach(neighborhood);
+    long span_y = reach.max_y - reach.min_y;
+    long span_x = reach.max_x - reach.min_x;
+    long per_line = std::max<long>(1, 64 / sizeof(T));
+
+    TileShape shape = requested;
+    if (shape.cols <= 0) {
+        long width = cacheSize(1) / 2 / (long) sizeof(T) / (span_y + 1) - span_x;
+        width = std::max(per_line, width / per_line * per_line);
+        //the strips are made of the same width, instead of leaving a thin one at the end
+        long strips = (cols + width - 1) / width;
+        width = ((cols + strips - 1) / strips + per_line - 1) / per_line * per_line;
+        shape.cols = (int) std::min<long>(width, cols);
+    }
+    shape.cols = std::max(1, std::min(shape.cols, cols));
+    if (shape.rows <= 0) {
+        long budget = cacheSize(2) / 2 / (long) sizeof(T);
+        long height = (budget - span_y * (shape.cols + span_x)) / (2 * shape.cols + span_x);
+        height = std::max<long>(1, height);
+        long strips = (cols + shape.cols - 1) / shape.cols;
+        long bands_needed = (minTiles + strips - 1) / strips;
+        if (bands_needed > 1) height = std::min<long>(height, std::max<long>(1, rows / bands_needed));
+        shape.rows = (int) std::min<long>(height, rows);
+    }
+    shape.rows = std::max(1, std::min(shape.rows, rows));
+    return shape;
+}
+
+/*
+Splits the region [start_row, end_row) x [start_col, end_col) in tiles of the given shape. The tiles are
+ordered by vertical strips, top to bottom inside each strip, so that consecutive tiles share their halo
+rows and a range of consecutive tiles (the chunks of the workers) is a compact block of the matrix.
+*/
+inline std::vector<Tile> makeTiles(int start_row, int end_row, int start_col, int end_col, TileShape shape) {
+    std::vector<Tile> tiles;
+    if (end_row <= start_row || end_col <= start_col) return tiles;
+    for (int col0 = start_col; col0 < end_col; col0 += shape.cols) {
+        int col1 = std::min(end_col, col0 + shape.cols);
+        for (int row0 = start_row; row0 < end_row; row0 += shape.rows) {
+            tiles.push_back(Tile{row0, std::min(end_row, row0 + shape.rows), col0, col1});
+        }
+    }
+    return tiles;
+}
+
+//tiles of the region calculated by the engines, with the shape chosen by tileShapeFor()
+template<typename T>
+std::vector<Tile> tilesFor(const StencilBounds& bounds, const std::vector<std::pair<int, int>>& neighborhood, int minTiles, TileShape requested) {
+    return makeTiles(bounds.start_row, bounds.end_row, bounds.start_col, bounds.end_col,
+        tileShapeFor<T>(bounds.rows(), bounds.cols(), neighborhood, minTiles, requested));
+}
+
+#endif
\ No newline at end of file
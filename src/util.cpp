@@ -3,7 +3,7 @@
 #include <vector>
 #include "util.h"
 
-double stencilAvgFunction(std::vector<double> vec) {
+double stencilAvgFunction(const std::vector<double>& vec) {
 	int size = vec.size();
 	int sum = 0;
 	for (int i = 0; i < size; i++) {
@@ -13,7 +13,7 @@ double stencilAvgFunction(std::vector<double> vec) {
 	return res;
 }
 
-double stencilSinFunction(std::vector<double> vec) {
+double stencilSinFunction(const std::vector<double>& vec) {
 	int size = vec.size();
 	double res = vec[0];
 	for (int j = 0; j < 500; j++) {
@@ -25,9 +25,9 @@ double stencilSinFunction(std::vector<double> vec) {
 	return res;
 }
 
-double stencilUnstableFunction(std::vector<double> vec) {
+double stencilUnstableFunction(const std::vector<double>& vec) {
 	double res = vec[0];
-	if(res < (max / 2)) {
+	if(res < (MAX_VALUE / 2)) {
 		//std::this_thread::sleep_for(std::chrono::milliseconds(100)); //sleeps for 0.1 seconds
 	} else {
 		//std::this_thread::sleep_for(std::chrono::milliseconds(200)); //sleeps for 0.2 seconds
@@ -35,4 +35,47 @@ double stencilUnstableFunction(std::vector<double> vec) {
 	//cout << "Calculation finished" << endl;
 	
 	return res;
+}
+
+double stencilLifeFunction(const std::vector<double>& vec) {
+	int size = vec.size();
+	int alive = 0;
+	for (int i = 1; i < size; i++) {
+		if (vec[i] != 0) alive++;
+	}
+	if (vec[0] != 0) {
+		return (alive == 2 || alive == 3) ? 1 : 0;
+	}
+	return alive == 3 ? 1 : 0;
+}
+
+std::function<double(const std::vector<double>&)> stencilFunctionByName(const std::string& name) {
+	if (name == "avg") return stencilAvgFunction;
+	if (name == "sin") return stencilSinFunction;
+	if (name == "unstable") return stencilUnstableFunction;
+	if (name == "life") return stencilLifeFunction;
+	return nullptr;
+}
+
+std::vector<std::string> stencilFunctionNames() {
+	return {"avg", "sin", "unstable", "life"};
+}
+
+std::vector<std::pair<int, int>> neighborhoodByName(const std::string& name) {
+	std::vector<std::pair<int, int>> neighborhood;
+	if (name == "vonneumann") {
+		//same order as in the drivers
+		neighborhood = {{-1, 0}, {1, 0}, {0, 1}, {0, -1}};
+	} else if (name == "moore") {
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				if (dy != 0 || dx != 0) neighborhood.push_back(std::pair<int, int>(dy, dx));
+			}
+		}
+	}
+	return neighborhood;
+}
+
+std::vector<std::string> neighborhoodNames() {
+	return {"vonneumann", "moore"};
 }
\ No newline at end of file
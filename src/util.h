@@ -1,7 +1,28 @@
+#ifndef UTIL_H
+#define UTIL_H
 
 #include <vector>
-#define max 10
+#include <functional>
+#include <string>
+#include <utility>
 
-double stencilAvgFunction(std::vector<double> vec);
-double stencilSinFunction(std::vector<double> vec);
-double stencilUnstableFunction(std::vector<double> vec);
\ No newline at end of file
+#define MAX_VALUE 10 //the initial values of the matrix are in [0, MAX_VALUE)
+#define CHUNKS_PER_WORKER 4 //chunks the indexes are split in, per worker
+
+double stencilAvgFunction(const std::vector<double>& vec);
+double stencilSinFunction(const std::vector<double>& vec);
+double stencilUnstableFunction(const std::vector<double>& vec);
+//Game of Life rule on a 0/1 matrix: vec[0] is the cell, the rest are its neighbors
+double stencilLifeFunction(const std::vector<double>& vec);
+
+//returns the stencil function with the given name, or an empty function if there isn't one
+std::function<double(const std::vector<double>&)> stencilFunctionByName(const std::string& name);
+//names of the stencil functions that can be selected by name
+std::vector<std::string> stencilFunctionNames();
+
+//returns the neighborhood with the given name ("vonneumann" or "moore"), or an empty one if there isn't one
+std::vector<std::pair<int, int>> neighborhoodByName(const std::string& name);
+//names of the neighborhoods that can be selected by name
+std::vector<std::string> neighborhoodNames();
+
+#endif
\ No newline at end of file
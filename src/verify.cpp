@@ -0,0 +1,329 @@
+#ifndef VERIFY_CPP
+#define VERIFY_CPP
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include "grid_view.cpp"
+#include "tiling.cpp"
+#include "grid_init.cpp"
+#include "parallel_chunks.cpp"
+#include "coefficients.cpp"
+#include "sequential.cpp"
+
+/*
+When two values are considered equal. Engines that split the work differently, or whose stencil functions are
+vectorized, can round differently, so an exact comparison fails on results that are correct. Two values are
+equal if they are within maxUlps representable values of each other, or if their difference is at most
+absolute or relative times the largest of the two. NaNs are equal to NaNs.
+*/
+struct Tolerance {
+    uint64_t maxUlps = 4;
+    double relative = 1e-12;
+    double absolute = 0;
+
+    static Tolerance exact() { return Tolerance{0, 0, 0}; }
+};
+
+/*
+Result of a verification: how many cells were checked, how many differ (with the first one in row-major
+order), and the largest differences seen.
+*/
+struct VerifyReport {
+    long checked = 0;
+    long mismatches = 0;
+    int row = -1, col = -1; //first mismatching cell, -1 if there is none
+    double maxAbsolute = 0;
+    double maxRelative = 0;
+    uint64_t maxUlps = 0;
+
+    bool ok() const { return mismatches == 0; }
+
+    //adds the cells of another (disjoint) part of the verification
+    void merge(const VerifyReport& other) {
+        checked += other.checked;
+        mismatches += other.mismatches;
+        if (other.row >= 0 && (row < 0 || other.row < row || (other.row == row && other.col < col))) {
+            row = other.row;
+            col = other.col;
+        }
+        maxAbsolute = std::max(maxAbsolute, other.maxAbsolute);
+        maxRelative = std::max(maxRelative, other.maxRelative);
+        maxUlps = std::max(maxUlps, other.maxUlps);
+    }
+};
+
+/*
+Number of representable values between a and b. The bits of a float or double, read as a sign-magnitude
+integer and mapped to two's complement, are ordered like the values, so the distance is the difference of
+the two integers. For integer types it's the difference of the values.
+*/
+template<typename T>
+uint64_t ulpDistance(T a, T b) {
+    if constexpr (std::is_floating_point_v<T>) {
+        if (a == b) return 0; //also +0 and -0
+        if (std::isnan(a) || std::isnan(b)) return std::numeric_limits<uint64_t>::max();
+        using Bits = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+        static_assert(sizeof(T) == sizeof(Bits), "ulpDistance supports float and double");
+        Bits ia, ib;
+        memcpy(&ia, &a, sizeof(T));
+        memcpy(&ib, &b, sizeof(T));
+        if (ia < 0) ia = std::numeric_limits<Bits>::min() - ia;
+        if (ib < 0) ib = std::numeric_limits<Bits>::min() - ib;
+        return ia > ib ? (uint64_t) ia - (uint64_t) ib : (uint64_t) ib - (uint64_t) ia;
+    } else {
+        return a > b ? (uint64_t) (a - b) : (uint64_t) (b - a);
+    }
+}
+
+//compares a single cell, and adds it to the report
+template<typename T>
+void compareCell(T a, T b, int i, int j, const Tolerance& tolerance, VerifyReport& report) {
+    report.checked++;
+    if (a == b) return;
+    if constexpr (std::is_floating_point_v<T>) {
+        if (std::isnan(a) && std::isnan(b)) return;
+    }
+    uint64_t ulps = ulpDistance(a, b);
+    double difference = std::fabs((double) a - (double) b);
+    double largest = std::max(std::fabs((double) a), std::fabs((double) b));
+    double relative = largest > 0 ? difference / largest : 0;
+    report.maxUlps = std::max(report.maxUlps, ulps);
+    if (!std::isnan(difference)) {
+        report.maxAbsolute = std::max(report.maxAbsolute, difference);
+        report.maxRelative = std::max(report.maxRelative, relative);
+    }
+    if (ulps <= tolerance.maxUlps || difference <= tolerance.absolute || relative <= tolerance.relative) return;
+    if (report.mismatches++ == 0) {
+        report.row = i;
+        report.col = j;
+    }
+}
+
+/*
+Compares two rows x cols matrices, given as functions that return the pointer to a row, in parallel over the
+rows. Every worker fills the report of its chunks, and the reports are merged at the end.
+*/
+template<typename T, typename RowA, typename RowB>
+VerifyReport compareRows(int rows, int cols, RowA rowA, RowB rowB, Tolerance tolerance, int nworkers) {
+    VerifyReport report;
+    std::mutex m;
+    parallelChunks(rows, nworkers, [&](int start, int stop) {
+        VerifyReport partial;
+        for (int i = start; i < stop; i++) {
+            const T* a = rowA(i);
+            const T* b = rowB(i);
+            for (int j = 0; j < cols; j++) {
+                compareCell(a[j], b[j], i, j, tolerance, partial);
+            }
+        }
+        std::lock_guard<std::mutex> lock(m);
+        report.merge(partial);
+    });
+    return report;
+}
+
+//compares two matrices cell by cell, within the tolerance
+template<typename T>
+VerifyReport compareGrids(const std::vector<std::vector<T>>& a, const std::vector<std::vector<T>>& b,
+                          Tolerance tolerance = Tolerance(), int nworkers = 1) {
+    int rows = a.size();
+    int cols = rows > 0 ? a[0].size() : 0;
+    if ((int) b.size() != rows || (rows > 0 && (int) b[0].size() != cols)) {
+        throw std::invalid_argument("the matrices don't have the same size");
+    }
+    return compareRows<T>(rows, cols, [&](int i) { return a[i].data(); }, [&](int i) { return b[i].data(); },
+                          tolerance, nworkers);
+}
+
+template<typename T>
+VerifyReport compareGrids(GridView<T> a, GridView<T> b, Tolerance tolerance = Tolerance(), int nworkers = 1) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) {
+        throw std::invalid_argument("the matrices don't have the same size");
+    }
+    return compareRows<T>(a.rows(), a.cols(), [&](int i) { return (const T*) a[i]; },
+                          [&](int i) { return (const T*) b[i]; }, tolerance, nworkers);
+}
+
+//64 bit mix function of splitmix64, so that close inputs give unrelated outputs
+inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/*
+Checksum of a matrix that doesn't depend on the order the cells are visited in: every cell is hashed with its
+position and the hashes are added modulo 2^64, so the rows can be summed in parallel and in any order, and
+the checksum is the same for any number of workers. It's meant to compare a run with a reference result
+stored as a single number: equal matrices have equal checksums (-0 is hashed as 0, and all the NaNs alike),
+while a single different bit changes it. Results that are only equal within a tolerance have different
+checksums, they have to be compared with compareGrids.
+*/
+template<typename T, typename Row>
+uint64_t checksumRows(int rows, int cols, Row row, int nworkers) {
+    uint64_t checksum = 0;
+    std::mutex m;
+    parallelChunks(rows, nworkers, [&](int start, int stop) {
+        uint64_t partial = 0;
+        for (int i = start; i < stop; i++) {
+            const T* values = row(i);
+            for (int j = 0; j < cols; j++) {
+                T value = values[j];
+                if constexpr (std::is_floating_point_v<T>) {
+                    if (value == 0) value = 0;
+                    if (std::isnan(value)) value = std::numeric_limits<T>::quiet_NaN();
+                }
+                uint64_t bits = 0;
+                memcpy(&bits, &value, std::min(sizeof(T), sizeof(bits)));
+                partial += mix64(bits ^ mix64(((uint64_t) i << 32) | (uint32_t) j));
+            }
+        }
+        std::lock_guard<std::mutex> lock(m);
+        checksum += partial;
+    });
+    return checksum ^ mix64(((uint64_t) rows << 32) | (uint32_t) cols);
+}
+
+template<typename T>
+uint64_t gridChecksum(const std::vector<std::vector<T>>& data, int nworkers = 1) {
+    int rows = data.size();
+    int cols = rows > 0 ? data[0].size() : 0;
+    return checksumRows<T>(rows, cols, [&](int i) { return data[i].data(); }, nworkers);
+}
+
+template<typename T>
+uint64_t gridChecksum(GridView<T> data, int nworkers = 1) {
+    return checksumRows<T>(data.rows(), data.cols(), [&](int i) { return (const T*) data[i]; }, nworkers);
+}
+
+/*
+Reference checksums are stored in a text file, one line with the size of the matrix and the checksum in
+hexadecimal, so that the result of a run can be checked against the one of a trusted run without storing the
+matrix.
+*/
+inline bool saveChecksum(const std::string& path, int rows, int cols, uint64_t checksum) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    bool ok = fprintf(f, "%d %d %016llx\n", rows, cols, (unsigned long long) checksum) > 0;
+    return (fclose(f) == 0) && ok;
+}
+
+inline bool loadChecksum(const std::string& path, int& rows, int& cols, uint64_t& checksum) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    unsigned long long value;
+    bool ok = fscanf(f, "%d %d %llx", &rows, &cols, &value) == 3;
+    fclose(f);
+    checksum = value;
+    return ok;
+}
+
+/*
+Checks the checksum of a matrix against the reference stored in path. The reference must be for a matrix of
+the same size; error tells why the check failed.
+*/
+template<typename T>
+bool verifyChecksum(const std::string& path, const std::vector<std::vector<T>>& data, int nworkers, std::string& error) {
+    int rows, cols;
+    uint64_t reference;
+    if (!loadChecksum(path, rows, cols, reference)) {
+        error = "can't read the reference checksum from " + path;
+        return false;
+    }
+    int numRows = data.size();
+    int numCols = numRows > 0 ? data[0].size() : 0;
+    if (rows != numRows || cols != numCols) {
+        error = "the reference checksum is for a " + std::to_string(rows) + "x" + std::to_string(cols) + " matrix";
+        return false;
+    }
+    if (gridChecksum(data, nworkers) != reference) {
+        error = "the checksum differs from the reference";
+        return false;
+    }
+    return true;
+}
+
+/*
+Sampled verification of the result of a stencil computation, without running the whole computation again.
+After k iterations a cell only depends on the input cells within k times the reach of the neighborhood, its
+dependency cone. For every sampled cell the cone is cut out of the input and the iterations are computed on
+it by StencilPatternSeq: the cells at the border of the cone are not updated by the engine, but the errors
+they cause move inwards by one reach per iteration and don't get to the center in k iterations. Where the
+cone is cut by the border of the matrix, the border isn't updated in the full computation either. The value
+at the center is then compared with the result.
+The cells are chosen with philoxRandom from the seed, and the samples are checked in parallel. A sample
+computes k iterations on a cone of about (2kr)^2 cells, for a reach r, so its cost grows with the cube of the
+iterations: it's cheap when the cones are small compared to the matrix, and once they cover it a sample
+costs as much as the sequential computation.
+The coefficient fields, if there are any, are cut like the input.
+*/
+template<typename T>
+VerifyReport verifySampled(const std::vector<std::vector<T>>& input, const std::vector<std::vector<T>>& result,
+                           std::function<T(const std::vector<T>&)> stencilFunc,
+                           const std::vector<std::pair<int, int>>& neighborhood, int iterations, int samples,
+                           uint64_t seed, Tolerance tolerance = Tolerance(), int nworkers = 1,
+                           const CoefficientFields<T>* coefficients = nullptr) {
+    int numRows = input.size();
+    int numCols = numRows > 0 ? input[0].size() : 0;
+    if ((int) result.size() != numRows || (numRows > 0 && (int) result[0].size() != numCols)) {
+        throw std::invalid_argument("the matrices don't have the same size");
+    }
+    if (coefficients) coefficients->check(numRows, numCols);
+    VerifyReport report;
+    if (numRows == 0 || numCols == 0) return report;
+
+    NeighborhoodReach reach = neighborhoodReach(neighborhood);
+
+    std::mutex m;
+    parallelChunks(samples, nworkers, [&](int start, int stop) {
+        VerifyReport partial;
+        std::vector<T> buffer_a, buffer_b;
+        for (int s = start; s < stop; s++) {
+            int i = philoxRandom(seed, s, 0) % numRows;
+            int j = philoxRandom(seed, s, 1) % numCols;
+            //the cone of the cell, cut by the border of the matrix
+            int row0 = std::max<long>(0, i + (long) iterations * reach.min_y);
+            int row1 = std::min<long>(numRows, i + (long) iterations * reach.max_y + 1);
+            int col0 = std::max<long>(0, j + (long) iterations * reach.min_x);
+            int col1 = std::min<long>(numCols, j + (long) iterations * reach.max_x + 1);
+            int rows = row1 - row0, cols = col1 - col0;
+
+            buffer_a.resize((size_t) rows * cols);
+            buffer_b.resize((size_t) rows * cols);
+            GridView<T> a(buffer_a.data(), rows, cols), b(buffer_b.data(), rows, cols);
+            for (int r = 0; r < rows; r++) {
+                std::copy(input[row0 + r].begin() + col0, input[row0 + r].begin() + col1, a[r]);
+            }
+            CoefficientFields<T> cone_coefficients;
+            StencilPatternSeq<T> seq(stencilFunc, neighborhood, iterations);
+            if (coefficients && coefficients->size() > 0) {
+                for (int f = 0; f < coefficients->size(); f++) {
+                    std::vector<std::vector<T>> field(rows);
+                    for (int r = 0; r < rows; r++) {
+                        field[r].assign((*coefficients)[f][row0 + r] + col0, (*coefficients)[f][row0 + r] + col1);
+                    }
+                    cone_coefficients.add(field);
+                }
+                seq.setCoefficients(&cone_coefficients);
+            }
+            GridView<T> cone_result = seq.compute(a, b) == 0 ? a : b;
+            compareCell(result[i][j], cone_result[i - row0][j - col0], i, j, tolerance, partial);
+        }
+        std::lock_guard<std::mutex> lock(m);
+        report.merge(partial);
+    });
+    return report;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef WORKER_POOL_CPP
+#define WORKER_POOL_CPP
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+Threads that are created once and then run the tasks they are given, so that the jobs of the service
+don't pay for the creation of the threads. run() executes task(worker id) on every worker and returns
+when all of them are done.
+*/
+class WorkerPool {
+public:
+    WorkerPool(int nworkers) {
+        for (int id = 0; id < nworkers; id++) {
+            threads.push_back(std::thread([this, id]() { loop(id); }));
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    void run(std::function<void(int)> task) {
+        std::unique_lock<std::mutex> lock(m);
+        current = task;
+        running = threads.size();
+        generation++;
+        cv.notify_all();
+        done.wait(lock, [this]() { return running == 0; });
+    }
+
+    int size() const { return threads.size(); }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex m;
+    std::condition_variable cv;
+    std::condition_variable done;
+    std::function<void(int)> current;
+    long generation = 0;
+    int running = 0;
+    bool stop = false;
+
+    void loop(int id) {
+        long seen = 0;
+        std::unique_lock<std::mutex> lock(m);
+        while (true) {
+            cv.wait(lock, [&]() { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+            auto task = current;
+            lock.unlock();
+            task(id);
+            lock.lock();
+            if (--running == 0) done.notify_all();
+        }
+    }
+};
+
+#endif
\ No newline at end of file